@@ -0,0 +1,720 @@
+/*
+  ==============================================================================
+
+    JafftuneBench.cpp
+    Headless benchmark for jafftune::PitchShiftEngine.
+
+    Drives the engine with synthetic audio across every Operation Mode (the
+    Harmonizer with --voices voices, 8 by default), a sweep of block sizes,
+    sample rates and pitch ratios, and prints one record per configuration
+    as JSON lines (default) or CSV:
+
+        jafftune_bench [--format json|csv] [--duration seconds] [--repeats n]
+                       [--mode m] [--block-size n] [--sample-rate hz]
+                       [--ratio r] [--interpolation linear|hermite]
+                       [--voices n] [--oversampling 1|2|4|all]
+                       [--algorithm delay|vocoder|formant]
+                       [--precision float|double|both] [--input tone|silence]
+                       [--quick] [--verify] [--verify-switches]
+
+    ns_per_sample is the wall time per sample frame (all channels), the
+    realtime factor is audio time over processing time, and instances per
+    core is how many engines one core could run in real time.
+
+    --oversampling runs the engine at 2x or 4x the sample rate, as the
+    plugin's Oversampling option does, and still reports per host-rate
+    sample frame. The up/down filters live in juce::dsp and are not part of
+    this JUCE-free benchmark; jafftune_oversampling_bench runs them too.
+
+    --algorithm vocoder runs the mono and stereo modes through the phase
+    vocoder (at its default Balanced quality) instead of the delay taps;
+    --algorithm formant does the same with formant preservation on.
+
+    --precision picks the engine's sample type, as a host does by asking for
+    single or double precision processing; "both" runs every configuration
+    through each so the two paths can be compared side by side.
+
+    --input silence feeds digital silence instead of the test signal, which
+    measures the engine once it has gone to sleep.
+
+    --verify instead runs every mode and ratio through both the engine and
+    a per-sample scalar reference of the original processBlock, and fails
+    if any output sample differs by more than verifyTolerance. It also runs
+    a StreamBank against one engine per stream, which must match exactly.
+
+    --verify-switches switches between every pair of modes, on each shifter,
+    and fails if the largest sample-to-sample step in the 100 ms after a
+    switch is more than switchStepLimit times the largest one either mode
+    makes on its own. Each pair, and each mode onto itself, is also run
+    across a handover to a second engine, as the plugin does when Channel
+    Mode or a setting that sizes the engines changes.
+
+  ==============================================================================
+*/
+
+#include "../Engine/AllocationTracker.h"
+#include "../Engine/PitchShiftEngine.h"
+#include "../Engine/StreamBank.h"
+#include "../Engine/VectorOps.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined (__SSE__) || defined (_M_X64) || defined (_M_IX86)
+ #include <xmmintrin.h>
+#endif
+
+namespace
+{
+
+//==============================================================================
+struct BenchConfig
+{
+    std::vector<int> modes        { 0, 1, 2, 3, 4, 5, 6 };
+    std::vector<int> blockSizes   { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+    std::vector<double> sampleRates { 44100.0, 48000.0, 88200.0, 96000.0, 176400.0, 192000.0 };
+    std::vector<float> ratios     { 0.5f, 0.75f, 1.0f, 1.5f, 2.0f };
+    std::vector<int> oversamplingFactors { 1 };
+    std::vector<bool> doublePrecision { false };
+
+    double durationSeconds = 0.5;
+    int repeats = 5;
+    bool csv = false;
+    bool verify = false;
+    bool verifySwitches = false;
+    int harmonyVoices = jafftune::PitchShiftEngine<float>::maxHarmonyVoices;
+    jafftune::Interpolation interpolation = jafftune::Interpolation::linear;
+    jafftune::Algorithm algorithm = jafftune::Algorithm::variableDelay;
+    bool preserveFormants = false;
+    bool silentInput = false;
+};
+
+//largest output difference allowed against the scalar reference (-80 dBFS)
+constexpr double verifyTolerance = 1.0e-4;
+
+//largest step allowed around a mode switch, relative to the steady output's (or the input's) largest step
+constexpr double switchStepLimit = 2.0;
+
+struct BenchResult
+{
+    double nsPerSample;
+    double realtimeFactor;
+    double instancesPerCore;
+};
+
+const char* modeNames[] = { "Mono Bypass", "Stereo Bypass", "Mono", "Stereo (Wet L, Wet R)", "Stereo (Dry L, Wet R)", "Harmonizer", "Pitch Correction" };
+
+//==============================================================================
+/** Flushes denormals to zero for the benchmark thread, as hosts do for processBlock. */
+void disableDenormals()
+{
+   #if defined (__SSE__) || defined (_M_X64) || defined (_M_IX86)
+    _mm_setcsr (_mm_getcsr() | 0x8040);
+   #endif
+}
+
+/** A band-limited-ish test signal: two detuned partials plus low-level noise. */
+template <typename SampleType>
+void fillSignal (std::vector<SampleType>& channel, double sampleRate, unsigned int seed)
+{
+    std::mt19937 random (seed);
+    std::uniform_real_distribution<float> noise (-0.05f, 0.05f);
+
+    for (size_t i = 0; i < channel.size(); ++i)
+    {
+        const auto t = (double) i / sampleRate;
+        //generated in float either way, so both precisions are fed the same samples
+        const auto sample = (float) (0.5 * std::sin (2.0 * 3.141592653589793 * 220.0 * t)
+                                   + 0.25 * std::sin (2.0 * 3.141592653589793 * 331.0 * t))
+                          + noise (random);
+        channel[i] = (SampleType) sample;
+    }
+}
+
+//==============================================================================
+/** The original per-sample processBlock algorithm: std::cos windows, fmod
+    offsets and an exp() per onePole call, reading a juce::dsp::DelayLine
+    style buffer. The phase comes from the engine's own double-precision
+    ramp, so a phase landing exactly on a cycle boundary wraps the same way
+    in both and only the windows, taps and mixing are being compared.
+*/
+void processReference (std::vector<std::vector<float>>& io, int mode, double sampleRate, float ratio,
+                       float dryGain, float wetGain, float outputGain)
+{
+    const auto pi = 3.14159265358979323846f;
+    const auto delayWindow = 22.0f;
+    const auto numSamples = io[0].size();
+    const auto bufferSize = (size_t) sampleRate + 1;
+
+    std::vector<std::vector<float>> history (2, std::vector<float> (bufferSize, 0.0f));
+    size_t writeIndex = 0;
+    double phase = 0.0;
+    const auto increment = 1000.0 * ((1.0 - (double) ratio) / (double) delayWindow) / sampleRate;
+    float lastDelayTimeOne = 0.0f, lastDelayTimeTwo = 0.0f;
+
+    auto onePole = [&] (float input, float past)
+    {
+        const auto a = std::exp (-2.0f * pi / (0.05f * 0.001f * (float) sampleRate));
+        return input * (1.0f - a) + past * a;
+    };
+
+    auto read = [&] (int ch, float delay)
+    {
+        const auto delayInt = (size_t) delay;
+        const auto frac = delay - (float) delayInt;
+        const auto one = (writeIndex + bufferSize - delayInt) % bufferSize;
+        const auto two = (one + bufferSize - 1) % bufferSize;
+        return history[(size_t) ch][one] + frac * (history[(size_t) ch][two] - history[(size_t) ch][one]);
+    };
+
+    for (size_t n = 0; n < numSamples; ++n)
+    {
+        auto& left = io[0][n];
+        auto& right = io[1][n];
+
+        if (mode == 0) { left *= outputGain; continue; }
+        if (mode == 1) { left *= outputGain; right *= outputGain; continue; }
+
+        history[0][writeIndex] = left;
+        history[1][writeIndex] = right;
+
+        float phasorTap = 0.0f;
+
+        if (increment != 0.0)
+            phase = jafftune::simd::fillPhasorRamp (&phasorTap, 1, phase, increment);
+
+        const auto windowInSamples = delayWindow * (float) (sampleRate / 1000.0);
+        const auto delayOne = onePole (phasorTap * windowInSamples, lastDelayTimeOne);
+        const auto delayTwo = onePole (std::fmod (phasorTap + 0.5f, 1.0f) * windowInSamples, lastDelayTimeTwo);
+        lastDelayTimeOne = delayOne;
+        lastDelayTimeTwo = delayTwo;
+
+        const auto gainOne = std::cos (((phasorTap - 0.5f) / 2.0f) * 2.0f * pi);
+        const auto gainTwo = std::cos (((std::fmod (phasorTap + 0.5f, 1.0f) - 0.5f) / 2.0f) * 2.0f * pi);
+
+        const auto wetL = (read (0, delayOne) * gainOne + read (0, delayTwo) * gainTwo) * wetGain + left * dryGain;
+        const auto wetR = (read (1, delayOne) * gainOne + read (1, delayTwo) * gainTwo) * wetGain + right * dryGain;
+
+        if (mode == 2)
+        {
+            left = wetL * outputGain;
+        }
+        else if (mode == 3)
+        {
+            left = wetL * outputGain;
+            right = wetR * outputGain;
+        }
+        else
+        {
+            const auto dry = (left + right) / 2.0f;
+            left = dry * outputGain;
+            right = ((wetL + wetR) / 2.0f) * outputGain;
+        }
+
+        writeIndex = (writeIndex + 1) % bufferSize;
+    }
+}
+
+/** Largest absolute difference between the engine and processReference. A
+    double engine is held to the same float reference, so it must agree to
+    within float rounding.
+*/
+template <typename SampleType>
+double verifyOne (const BenchConfig& config, int mode, int blockSize, double sampleRate, float ratio)
+{
+    const auto numSamples = std::max (blockSize, (int) (config.durationSeconds * sampleRate));
+
+    std::vector<std::vector<SampleType>> engineOutput (2, std::vector<SampleType> ((size_t) numSamples));
+    fillSignal (engineOutput[0], sampleRate, 1234u);
+    fillSignal (engineOutput[1], sampleRate, 1235u);
+
+    std::vector<std::vector<float>> referenceOutput (2, std::vector<float> ((size_t) numSamples));
+    fillSignal (referenceOutput[0], sampleRate, 1234u);
+    fillSignal (referenceOutput[1], sampleRate, 1235u);
+
+    //parameters go in before prepare, so they apply from the first sample instead of ramping in
+    jafftune::PitchShiftEngine<SampleType> engine;
+    engine.setPitchRatio (ratio);
+    engine.setMix (0.5f, 0.5f);
+    engine.setOutputGain (0.8f);
+    engine.prepare (sampleRate, blockSize, 2);
+
+    for (int start = 0; start < numSamples; start += blockSize)
+    {
+        jafftune::ScopedNoAllocation noAllocation;
+        SampleType* channels[] = { engineOutput[0].data() + start, engineOutput[1].data() + start };
+        engine.process (channels, 2, std::min (blockSize, numSamples - start), static_cast<jafftune::OperationMode> (mode));
+    }
+
+    processReference (referenceOutput, mode, sampleRate, ratio, 0.5f, 0.5f, 0.8f);
+
+    double maxError = 0.0;
+
+    for (size_t ch = 0; ch < 2; ++ch)
+        for (size_t i = 0; i < (size_t) numSamples; ++i)
+            maxError = std::max (maxError, std::abs ((double) engineOutput[ch][i] - (double) referenceOutput[ch][i]));
+
+    return maxError;
+}
+
+/** Number of output samples where a StreamBank differs from a
+    PitchShiftEngine<float> per stream in OperationMode::mono. A stream for
+    each ratio and interpolation; half of them fall silent partway, so the
+    banked streams have to go to sleep on the same block as their engines.
+*/
+size_t verifyBank (const BenchConfig& config, int blockSize, double sampleRate)
+{
+    constexpr auto maximumWindow = 100.0f;
+    const auto numSamples = blockSize * (int) std::ceil (sampleRate / blockSize);
+    const auto numStreams = (int) config.ratios.size() * 2;
+
+    jafftune::StreamBank bank;
+    bank.prepare (sampleRate, numStreams, maximumWindow);
+
+    std::vector<int> streams;
+    std::vector<std::unique_ptr<jafftune::PitchShiftEngine<float>>> engines;
+    std::vector<std::vector<float>> bankOutput, engineOutput;
+
+    for (int s = 0; s < numStreams; ++s)
+    {
+        jafftune::StreamSettings settings;
+        settings.pitchRatio = config.ratios[(size_t) s / 2];
+        settings.dryGain = 0.3f;
+        settings.wetGain = 0.7f;
+        settings.outputGain = 0.8f;
+        settings.delayWindowMs = jafftune::PitchShiftEngine<float>::windowForRatio (settings.pitchRatio, maximumWindow);
+        settings.interpolation = s % 2 == 0 ? jafftune::Interpolation::linear : jafftune::Interpolation::hermite;
+        streams.push_back (bank.openStream (settings));
+
+        auto engine = std::make_unique<jafftune::PitchShiftEngine<float>>();
+        engine->setMaximumDelayWindow (maximumWindow);
+        engine->setDelayWindow (settings.delayWindowMs);
+        engine->setPitchRatio (settings.pitchRatio);
+        engine->setMix (settings.dryGain, settings.wetGain);
+        engine->setOutputGain (settings.outputGain);
+        engine->setInterpolation (settings.interpolation);
+        engine->prepare (sampleRate, blockSize, 1);
+        engines.push_back (std::move (engine));
+
+        std::vector<float> input ((size_t) numSamples);
+        fillSignal (input, sampleRate, 1234u + (unsigned int) s);
+
+        if ((s / 2) % 2 == 1)
+            std::fill (input.begin() + numSamples / 4, input.end(), 0.0f);
+
+        bankOutput.push_back (input);
+        engineOutput.push_back (input);
+    }
+
+    std::vector<float*> blocks ((size_t) numStreams);
+
+    for (int start = 0; start < numSamples; start += blockSize)
+    {
+        jafftune::ScopedNoAllocation noAllocation;
+
+        for (int s = 0; s < numStreams; ++s)
+        {
+            float* channels[] = { engineOutput[(size_t) s].data() + start };
+            engines[(size_t) s]->process (channels, 1, blockSize, jafftune::OperationMode::mono);
+            blocks[(size_t) s] = bankOutput[(size_t) s].data() + start;
+        }
+
+        bank.process (streams.data(), blocks.data(), numStreams, blockSize);
+    }
+
+    size_t mismatches = 0;
+
+    for (int s = 0; s < numStreams; ++s)
+        for (int i = 0; i < numSamples; ++i)
+            mismatches += bankOutput[(size_t) s][(size_t) i] != engineOutput[(size_t) s][(size_t) i] ? 1 : 0;
+
+    return mismatches;
+}
+
+/** Largest sample-to-sample step in the 100 ms after a switch from one mode
+    to another, over the largest step in the input or in either mode's
+    steady output. A pure two-tone input, so a click stands out of its slope.
+    With handOver set, the new mode runs on a second engine, which takes over
+    from bypass once the first has faded out to it.
+*/
+template <typename SampleType>
+double verifySwitch (int fromMode, int toMode, jafftune::Algorithm algorithm, double sampleRate, bool handOver)
+{
+    constexpr int blockSize = 128;
+    const auto switchSample = blockSize * (int) (0.5 * sampleRate / blockSize);
+    const auto numSamples = switchSample + (int) (0.3 * sampleRate);
+
+    std::vector<std::vector<SampleType>> io (2, std::vector<SampleType> ((size_t) numSamples));
+    auto inputStep = 0.0;
+
+    for (size_t ch = 0; ch < 2; ++ch)
+    {
+        const auto frequency = ch == 0 ? 150.0 : 205.0;
+
+        for (size_t i = 0; i < io[ch].size(); ++i)
+            io[ch][i] = (SampleType) (float) (0.4 * std::sin (2.0 * 3.141592653589793 * frequency * (double) i / sampleRate));
+
+        for (size_t i = 1; i < io[ch].size(); ++i)
+            inputStep = std::max (inputStep, std::abs ((double) io[ch][i] - (double) io[ch][i - 1]));
+    }
+
+    //a long window and two voices, so the delay taps have the most history to warm up
+    jafftune::PitchShiftEngine<SampleType> engines[2];
+
+    for (auto& engine : engines)
+    {
+        engine.setPitchRatio (0.8f);
+        engine.setMix (0.5f, 0.5f);
+        engine.setOutputGain (0.7f);
+        engine.setAlgorithm (algorithm);
+        engine.setMaximumDelayWindow (100.0f);
+        engine.setDelayWindow (50.0f);
+        engine.setNumHarmonyVoices (2);
+        engine.setHarmonyVoice (0, 1.25f, 0.5f, -0.5f);
+        engine.setHarmonyVoice (1, 1.5f, 0.5f, 0.5f);
+        engine.prepare (sampleRate, blockSize, 2);
+    }
+
+    //the bypass that leaves the channels the old mode doesn't shift as they were
+    const auto bypassMode = fromMode == (int) jafftune::OperationMode::monoBypass || fromMode == (int) jafftune::OperationMode::mono
+                          ? jafftune::OperationMode::monoBypass
+                          : jafftune::OperationMode::stereoBypass;
+    auto* engine = &engines[0];
+
+    for (int start = 0; start < numSamples; start += blockSize)
+    {
+        jafftune::ScopedNoAllocation noAllocation;
+        SampleType* channels[] = { io[0].data() + start, io[1].data() + start };
+        auto mode = static_cast<jafftune::OperationMode> (start < switchSample ? fromMode : toMode);
+
+        if (handOver && start >= switchSample && engine == &engines[0])
+        {
+            if (engine->isBypassed())
+            {
+                engines[1].resetToBypass (bypassMode);
+                engine = &engines[1];
+            }
+            else
+            {
+                mode = bypassMode;
+            }
+        }
+
+        engine->process (channels, 2, std::min (blockSize, numSamples - start), mode);
+    }
+
+    //each steady part leaves 100 ms for the taps, or the switch, to settle
+    const auto settled = (size_t) (0.1 * sampleRate);
+    const auto switchEnd = (size_t) switchSample + settled;
+    auto steadyStep = inputStep;
+    auto switchStep = 0.0;
+
+    for (size_t ch = 0; ch < 2; ++ch)
+    {
+        for (auto i = settled; i < io[ch].size(); ++i)
+        {
+            const auto step = std::abs ((double) io[ch][i] - (double) io[ch][i - 1]);
+            const auto duringSwitch = i >= (size_t) switchSample && i < switchEnd;
+
+            if (duringSwitch)
+                switchStep = std::max (switchStep, step);
+            else
+                steadyStep = std::max (steadyStep, step);
+        }
+    }
+
+    return switchStep / steadyStep;
+}
+
+template <typename SampleType>
+BenchResult runOne (const BenchConfig& config, int mode, int blockSize, double hostSampleRate, float ratio, int oversampling)
+{
+    //the engine sees the oversampled rate and block size; results are per host-rate sample frame
+    constexpr int numChannels = 2;
+    const auto sampleRate = hostSampleRate * oversampling;
+    blockSize *= oversampling;
+    const auto numSamples = std::max (blockSize, (int) (config.durationSeconds * sampleRate));
+
+    std::vector<std::vector<SampleType>> source (numChannels, std::vector<SampleType> ((size_t) numSamples));
+    if (! config.silentInput)
+        for (int ch = 0; ch < numChannels; ++ch)
+            fillSignal (source[(size_t) ch], sampleRate, 1234u + (unsigned int) ch);
+
+    auto work = source;
+
+    jafftune::PitchShiftEngine<SampleType> engine;
+    engine.setPitchRatio (ratio);
+    engine.setMix (0.5f, 0.5f);
+    engine.setOutputGain (0.8f);
+    engine.setInterpolation (config.interpolation);
+    engine.setAlgorithm (config.algorithm);
+    engine.setFormantPreservation (config.preserveFormants, 1.0f);
+
+    //harmonizer voices spread around the swept ratio
+    engine.setNumHarmonyVoices (config.harmonyVoices);
+
+    for (int v = 0; v < jafftune::PitchShiftEngine<SampleType>::maxHarmonyVoices; ++v)
+        engine.setHarmonyVoice (v, ratio * (1.0f + 0.05f * (float) v), 0.5f, v % 2 == 0 ? -0.5f : 0.5f);
+
+    engine.prepare (sampleRate, blockSize, numChannels);
+
+    auto runPass = [&]
+    {
+        for (int start = 0; start < numSamples; start += blockSize)
+        {
+            const auto numThisTime = std::min (blockSize, numSamples - start);
+            SampleType* channels[numChannels] = { work[0].data() + start, work[1].data() + start };
+            engine.process (channels, numChannels, numThisTime, static_cast<jafftune::OperationMode> (mode));
+        }
+    };
+
+    //one untimed pass to warm caches and settle the phasor
+    runPass();
+
+    std::vector<double> timesNs;
+
+    for (int r = 0; r < config.repeats; ++r)
+    {
+        work = source;
+
+        const auto startTime = std::chrono::steady_clock::now();
+        runPass();
+        const auto endTime = std::chrono::steady_clock::now();
+
+        timesNs.push_back ((double) std::chrono::duration_cast<std::chrono::nanoseconds> (endTime - startTime).count());
+    }
+
+    //median is robust against the odd preempted run
+    std::sort (timesNs.begin(), timesNs.end());
+    const auto medianNs = std::max (1.0, timesNs[timesNs.size() / 2]);
+
+    BenchResult result;
+    result.nsPerSample = medianNs * oversampling / numSamples;
+    result.realtimeFactor = ((double) numSamples / sampleRate) * 1.0e9 / medianNs;
+    result.instancesPerCore = std::floor (result.realtimeFactor);
+    return result;
+}
+
+//==============================================================================
+void printHeader (const BenchConfig& config)
+{
+    if (config.csv)
+        std::printf ("mode,mode_name,algorithm,precision,input,interpolation,oversampling,block_size,sample_rate,pitch_ratio,ns_per_sample,realtime_factor,instances_per_core\n");
+}
+
+void printResult (const BenchConfig& config, int mode, int blockSize, double sampleRate, float ratio, int oversampling,
+                  bool doublePrecision, const BenchResult& result)
+{
+    const auto* precision = doublePrecision ? "double" : "float";
+    const auto* input = config.silentInput ? "silence" : "tone";
+    const auto* interpolation = config.interpolation == jafftune::Interpolation::hermite ? "hermite" : "linear";
+    const auto* algorithm = config.preserveFormants ? "formant"
+                          : config.algorithm == jafftune::Algorithm::phaseVocoder ? "vocoder" : "delay";
+
+    if (config.csv)
+    {
+        std::printf ("%d,\"%s\",%s,%s,%s,%s,%d,%d,%.0f,%.3f,%.3f,%.2f,%.0f\n",
+                     mode, modeNames[mode], algorithm, precision, input, interpolation, oversampling, blockSize, sampleRate, (double) ratio,
+                     result.nsPerSample, result.realtimeFactor, result.instancesPerCore);
+    }
+    else
+    {
+        std::printf ("{\"mode\":%d,\"mode_name\":\"%s\",\"algorithm\":\"%s\",\"precision\":\"%s\",\"input\":\"%s\",\"interpolation\":\"%s\",\"oversampling\":%d,\"block_size\":%d,"
+                     "\"sample_rate\":%.0f,\"pitch_ratio\":%.3f,\"ns_per_sample\":%.3f,\"realtime_factor\":%.2f,\"instances_per_core\":%.0f}\n",
+                     mode, modeNames[mode], algorithm, precision, input, interpolation, oversampling, blockSize, sampleRate, (double) ratio,
+                     result.nsPerSample, result.realtimeFactor, result.instancesPerCore);
+    }
+
+    std::fflush (stdout);
+}
+
+void printUsage()
+{
+    std::fprintf (stderr,
+                  "usage: jafftune_bench [--format json|csv] [--duration seconds] [--repeats n]\n"
+                  "                      [--mode 0-6] [--block-size n] [--sample-rate hz] [--ratio r]\n"
+                  "                      [--interpolation linear|hermite] [--voices 1-8] [--oversampling 1|2|4|all]\n"
+                  "                      [--algorithm delay|vocoder|formant] [--precision float|double|both]\n"
+                  "                      [--input tone|silence] [--quick] [--verify] [--verify-switches]\n");
+}
+
+bool parseArguments (int argc, char* argv[], BenchConfig& config)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg (argv[i]);
+        const auto hasValue = i + 1 < argc;
+
+        if (arg == "--format" && hasValue)             config.csv = std::strcmp (argv[++i], "csv") == 0;
+        else if (arg == "--duration" && hasValue)      config.durationSeconds = std::atof (argv[++i]);
+        else if (arg == "--repeats" && hasValue)       config.repeats = std::max (1, std::atoi (argv[++i]));
+        else if (arg == "--mode" && hasValue)          config.modes = { std::atoi (argv[++i]) };
+        else if (arg == "--block-size" && hasValue)    config.blockSizes = { std::max (1, std::atoi (argv[++i])) };
+        else if (arg == "--sample-rate" && hasValue)   config.sampleRates = { std::atof (argv[++i]) };
+        else if (arg == "--ratio" && hasValue)         config.ratios = { (float) std::atof (argv[++i]) };
+        else if (arg == "--verify")                    config.verify = true;
+        else if (arg == "--verify-switches")           config.verifySwitches = true;
+        else if (arg == "--voices" && hasValue)        config.harmonyVoices = std::atoi (argv[++i]);
+        else if (arg == "--oversampling" && hasValue)
+            config.oversamplingFactors = std::strcmp (argv[++i], "all") == 0 ? std::vector<int> { 1, 2, 4 }
+                                                                             : std::vector<int> { std::atoi (argv[i]) };
+        else if (arg == "--algorithm" && hasValue)
+        {
+            const std::string algorithm (argv[++i]);
+            config.preserveFormants = algorithm == "formant";
+            config.algorithm = algorithm == "vocoder" || config.preserveFormants ? jafftune::Algorithm::phaseVocoder
+                                                                                 : jafftune::Algorithm::variableDelay;
+        }
+        else if (arg == "--precision" && hasValue)
+        {
+            const std::string precision (argv[++i]);
+            config.doublePrecision = precision == "both" ? std::vector<bool> { false, true }
+                                                         : std::vector<bool> { precision == "double" };
+        }
+        else if (arg == "--input" && hasValue)          config.silentInput = std::strcmp (argv[++i], "silence") == 0;
+        else if (arg == "--interpolation" && hasValue)
+            config.interpolation = std::strcmp (argv[++i], "hermite") == 0 ? jafftune::Interpolation::hermite
+                                                                           : jafftune::Interpolation::linear;
+        else if (arg == "--quick")
+        {
+            config.blockSizes = { 16, 256, 4096 };
+            config.sampleRates = { 48000.0, 192000.0 };
+            config.ratios = { 0.5f, 2.0f };
+            config.durationSeconds = 0.25;
+            config.repeats = 3;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    for (auto mode : config.modes)
+        if (mode < 0 || mode >= (int) jafftune::OperationMode::numModes)
+            return false;
+
+    for (auto factor : config.oversamplingFactors)
+        if (factor != 1 && factor != 2 && factor != 4)
+            return false;
+
+    return config.durationSeconds > 0.0;
+}
+
+} // namespace
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    BenchConfig config;
+
+    if (! parseArguments (argc, argv, config))
+    {
+        printUsage();
+        return 1;
+    }
+
+    disableDenormals();
+
+    if (config.verify)
+    {
+        auto worstError = 0.0;
+
+        for (auto mode : config.modes)
+            for (auto sampleRate : config.sampleRates)
+                for (auto ratio : config.ratios)
+                {
+                    //the harmonizer and pitch correction have no counterpart in the original processBlock
+                    if (mode >= (int) jafftune::OperationMode::harmonizer)
+                        continue;
+
+                    for (auto useDouble : config.doublePrecision)
+                    {
+                        //an odd block size exercises the engine's internal chunking
+                        const auto error = useDouble ? verifyOne<double> (config, mode, 1000, sampleRate, ratio)
+                                                     : verifyOne<float> (config, mode, 1000, sampleRate, ratio);
+                        worstError = std::max (worstError, error);
+
+                        std::printf ("{\"mode\":%d,\"precision\":\"%s\",\"sample_rate\":%.0f,\"pitch_ratio\":%.3f,\"max_error\":%.3g}\n",
+                                     mode, useDouble ? "double" : "float", sampleRate, (double) ratio, error);
+                    }
+                }
+
+        //the bank promises the engine's exact output, so any difference fails
+        size_t bankMismatches = 0;
+
+        for (auto sampleRate : config.sampleRates)
+        {
+            const auto mismatches = verifyBank (config, 1000, sampleRate);
+            bankMismatches += mismatches;
+
+            std::printf ("{\"check\":\"stream_bank\",\"sample_rate\":%.0f,\"mismatching_samples\":%zu}\n",
+                         sampleRate, mismatches);
+        }
+
+        //only meaningful in builds with JAFFTUNE_TRACK_ALLOCATIONS
+        const auto allocations = jafftune::ScopedNoAllocation::getViolationCount();
+        const auto passed = worstError <= verifyTolerance && bankMismatches == 0 && allocations == 0;
+
+        std::printf ("{\"max_error\":%.3g,\"tolerance\":%.3g,\"bank_mismatches\":%zu,\"audio_thread_allocations\":%zu,\"passed\":%s}\n",
+                     worstError, verifyTolerance, bankMismatches, allocations, passed ? "true" : "false");
+
+        return passed ? 0 : 1;
+    }
+
+    if (config.verifySwitches)
+    {
+        auto worstRatio = 0.0;
+        const jafftune::Algorithm algorithms[] = { jafftune::Algorithm::variableDelay, jafftune::Algorithm::phaseVocoder };
+
+        for (auto handOver : { false, true })
+            for (auto algorithm : algorithms)
+                for (auto fromMode : config.modes)
+                    for (auto toMode : config.modes)
+                    {
+                        //a handover keeping the mode is what a Channel Mode change does
+                        if (fromMode == toMode && ! handOver)
+                            continue;
+
+                        for (auto useDouble : config.doublePrecision)
+                        {
+                            const auto ratio = useDouble ? verifySwitch<double> (fromMode, toMode, algorithm, 48000.0, handOver)
+                                                         : verifySwitch<float> (fromMode, toMode, algorithm, 48000.0, handOver);
+                            worstRatio = std::max (worstRatio, ratio);
+
+                            std::printf ("{\"algorithm\":\"%s\",\"from_mode\":%d,\"to_mode\":%d,\"handover\":%s,\"precision\":\"%s\",\"step_ratio\":%.3f}\n",
+                                         algorithm == jafftune::Algorithm::phaseVocoder ? "vocoder" : "delay",
+                                         fromMode, toMode, handOver ? "true" : "false", useDouble ? "double" : "float", ratio);
+                        }
+                    }
+
+        const auto allocations = jafftune::ScopedNoAllocation::getViolationCount();
+        const auto passed = worstRatio <= switchStepLimit && allocations == 0;
+
+        std::printf ("{\"max_step_ratio\":%.3f,\"limit\":%.3g,\"audio_thread_allocations\":%zu,\"passed\":%s}\n",
+                     worstRatio, switchStepLimit, allocations, passed ? "true" : "false");
+
+        return passed ? 0 : 1;
+    }
+
+    printHeader (config);
+
+    for (auto mode : config.modes)
+        for (auto oversampling : config.oversamplingFactors)
+            for (auto sampleRate : config.sampleRates)
+                for (auto blockSize : config.blockSizes)
+                    for (auto ratio : config.ratios)
+                        for (auto useDouble : config.doublePrecision)
+                            printResult (config, mode, blockSize, sampleRate, ratio, oversampling, useDouble,
+                                         useDouble ? runOne<double> (config, mode, blockSize, sampleRate, ratio, oversampling)
+                                                   : runOne<float> (config, mode, blockSize, sampleRate, ratio, oversampling));
+
+    return 0;
+}
@@ -0,0 +1,276 @@
+/*
+  ==============================================================================
+
+    JafftuneOversamplingBench.cpp
+    Benchmark of jafftune::PitchShiftEngine behind juce::dsp::Oversampling.
+
+    Runs one engine the way the plugin's Oversampling option does: at the
+    host rate, then at 2x and 4x between the up and down filters, with both
+    of the plugin's filter choices (polyphase IIR and linear phase FIR, at
+    maximum quality with integer latency). Prints one JSON record per
+    configuration and a last one checking the budget:
+
+        jafftune_oversampling_bench [--duration seconds] [--repeats n]
+                                    [--mode m] [--block-size n] [--sample-rate hz]
+                                    [--ratio r] [--precision float|double]
+
+    ns_per_sample is the wall time per host-rate sample frame (all channels),
+    filter_ns_per_sample the part of it the up and down filters take on their
+    own, and cost_vs_1x the whole over the engine at the host rate. 2x must
+    cost less than oversamplingBudget times 1x with either filter, or the exit
+    code is 1.
+
+    jafftune_bench times the engine alone at 2x and 4x; this one needs JUCE
+    for the filters.
+
+  ==============================================================================
+*/
+
+#include <juce_dsp/juce_dsp.h>
+
+#include "../Engine/PitchShiftEngine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//==============================================================================
+struct BenchConfig
+{
+    double durationSeconds = 2.0;
+    int repeats = 5;
+    int mode = (int) jafftune::OperationMode::stereoWetWet;
+    int blockSize = 512;
+    double sampleRate = 48000.0;
+    float ratio = 1.5f;
+    bool doublePrecision = false;
+};
+
+//2x oversampling, filters included, may cost at most this many times the engine at the host rate
+constexpr double oversamplingBudget = 2.5;
+
+//the plugin's Oversampling Filter choices, in its order
+const char* filterNames[] = { "iir", "fir" };
+
+struct BenchResult
+{
+    double nsPerSample = 0.0;
+    double filterNsPerSample = 0.0;
+    int latencyInSamples = 0;
+};
+
+//==============================================================================
+template <typename SampleType>
+void fillSignal (juce::AudioBuffer<SampleType>& buffer, double sampleRate)
+{
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+    {
+        std::mt19937 random (1234u + (unsigned int) ch);
+        std::uniform_real_distribution<float> noise (-0.05f, 0.05f);
+        auto* samples = buffer.getWritePointer (ch);
+
+        for (int i = 0; i < buffer.getNumSamples(); ++i)
+        {
+            const auto t = (double) i / sampleRate;
+            samples[i] = (SampleType) ((float) (0.5 * std::sin (2.0 * juce::MathConstants<double>::pi * 220.0 * t)
+                                              + 0.25 * std::sin (2.0 * juce::MathConstants<double>::pi * 331.0 * t))
+                                       + noise (random));
+        }
+    }
+}
+
+/** Times the engine at 2 to the stages times the host rate, behind the chosen
+    filter, and the filters again without it.
+*/
+template <typename SampleType>
+BenchResult runOne (const BenchConfig& config, int stages, int filter)
+{
+    using Oversampling = juce::dsp::Oversampling<SampleType>;
+    constexpr int numChannels = 2;
+    const auto factor = 1 << stages;
+    const auto numSamples = std::max (config.blockSize, (int) (config.durationSeconds * config.sampleRate));
+
+    juce::AudioBuffer<SampleType> source (numChannels, numSamples);
+    fillSignal (source, config.sampleRate);
+
+    juce::AudioBuffer<SampleType> work;
+    work.makeCopyOf (source);
+
+    //as the plugin builds it: maximum quality, integer latency
+    std::unique_ptr<Oversampling> oversampler;
+
+    if (stages > 0)
+    {
+        oversampler = std::make_unique<Oversampling> ((size_t) numChannels, (size_t) stages,
+                                                      filter == 0 ? Oversampling::filterHalfBandPolyphaseIIR
+                                                                  : Oversampling::filterHalfBandFIREquiripple,
+                                                      true, true);
+        oversampler->initProcessing ((size_t) config.blockSize);
+    }
+
+    jafftune::PitchShiftEngine<SampleType> engine;
+    engine.setPitchRatio (config.ratio);
+    engine.setMix (0.5f, 0.5f);
+    engine.setOutputGain (0.8f);
+    engine.setNumHarmonyVoices (2);
+    engine.prepare (config.sampleRate * factor, config.blockSize * factor, numChannels);
+
+    const auto mode = static_cast<jafftune::OperationMode> (config.mode);
+
+    auto runPass = [&] (bool withEngine)
+    {
+        for (int start = 0; start < numSamples; start += config.blockSize)
+        {
+            const auto numThisTime = std::min (config.blockSize, numSamples - start);
+            juce::dsp::AudioBlock<SampleType> block (work.getArrayOfWritePointers(), (size_t) numChannels,
+                                                     (size_t) start, (size_t) numThisTime);
+
+            if (oversampler == nullptr)
+            {
+                SampleType* channels[] = { block.getChannelPointer (0), block.getChannelPointer (1) };
+                engine.process (channels, numChannels, numThisTime, mode);
+                continue;
+            }
+
+            auto oversampled = oversampler->processSamplesUp (block);
+
+            if (withEngine)
+            {
+                SampleType* channels[] = { oversampled.getChannelPointer (0), oversampled.getChannelPointer (1) };
+                engine.process (channels, numChannels, (int) oversampled.getNumSamples(), mode);
+            }
+
+            oversampler->processSamplesDown (block);
+        }
+    };
+
+    auto timePasses = [&] (bool withEngine)
+    {
+        //one untimed pass to warm caches and fill the filters
+        runPass (withEngine);
+
+        std::vector<double> timesNs;
+
+        for (int r = 0; r < config.repeats; ++r)
+        {
+            work.makeCopyOf (source);
+
+            const auto startTime = std::chrono::steady_clock::now();
+            runPass (withEngine);
+            const auto endTime = std::chrono::steady_clock::now();
+
+            timesNs.push_back ((double) std::chrono::duration_cast<std::chrono::nanoseconds> (endTime - startTime).count());
+        }
+
+        //median is robust against the odd preempted run
+        std::sort (timesNs.begin(), timesNs.end());
+        return std::max (1.0, timesNs[timesNs.size() / 2]) / numSamples;
+    };
+
+    BenchResult result;
+    result.nsPerSample = timePasses (true);
+
+    if (oversampler != nullptr)
+    {
+        result.filterNsPerSample = timePasses (false);
+        result.latencyInSamples = (int) oversampler->getLatencyInSamples();
+    }
+
+    return result;
+}
+
+//==============================================================================
+void printResult (const BenchConfig& config, const char* filter, int factor, const BenchResult& result, double baseNsPerSample)
+{
+    std::printf ("{\"filter\":\"%s\",\"oversampling\":%d,\"mode\":%d,\"precision\":\"%s\",\"block_size\":%d,"
+                 "\"sample_rate\":%.0f,\"pitch_ratio\":%.3f,\"ns_per_sample\":%.3f,\"filter_ns_per_sample\":%.3f,"
+                 "\"realtime_factor\":%.2f,\"cost_vs_1x\":%.3f,\"latency_samples\":%d}\n",
+                 filter, factor, config.mode, config.doublePrecision ? "double" : "float", config.blockSize,
+                 config.sampleRate, (double) config.ratio, result.nsPerSample, result.filterNsPerSample,
+                 1.0e9 / (result.nsPerSample * config.sampleRate), result.nsPerSample / baseNsPerSample,
+                 result.latencyInSamples);
+}
+
+void printUsage()
+{
+    std::fprintf (stderr,
+                  "usage: jafftune_oversampling_bench [--duration seconds] [--repeats n]\n"
+                  "                                   [--mode 0-6] [--block-size n] [--sample-rate hz]\n"
+                  "                                   [--ratio r] [--precision float|double]\n");
+}
+
+bool parseArguments (int argc, char* argv[], BenchConfig& config)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg (argv[i]);
+        const auto hasValue = i + 1 < argc;
+
+        if (arg == "--duration" && hasValue)           config.durationSeconds = std::atof (argv[++i]);
+        else if (arg == "--repeats" && hasValue)       config.repeats = std::max (1, std::atoi (argv[++i]));
+        else if (arg == "--mode" && hasValue)          config.mode = std::atoi (argv[++i]);
+        else if (arg == "--block-size" && hasValue)    config.blockSize = std::max (1, std::atoi (argv[++i]));
+        else if (arg == "--sample-rate" && hasValue)   config.sampleRate = std::atof (argv[++i]);
+        else if (arg == "--ratio" && hasValue)         config.ratio = (float) std::atof (argv[++i]);
+        else if (arg == "--precision" && hasValue)     config.doublePrecision = std::string (argv[++i]) == "double";
+        else                                           return false;
+    }
+
+    return config.mode >= 0 && config.mode < (int) jafftune::OperationMode::numModes
+        && config.durationSeconds > 0.0 && config.sampleRate > 0.0;
+}
+
+template <typename SampleType>
+int runAll (const BenchConfig& config)
+{
+    const auto base = runOne<SampleType> (config, 0, 0);
+    printResult (config, "none", 1, base, base.nsPerSample);
+
+    double costAt2x[2] = {};
+
+    for (int filter = 0; filter < 2; ++filter)
+    {
+        for (int stages = 1; stages <= 2; ++stages)
+        {
+            const auto result = runOne<SampleType> (config, stages, filter);
+            printResult (config, filterNames[filter], 1 << stages, result, base.nsPerSample);
+
+            if (stages == 1)
+                costAt2x[filter] = result.nsPerSample / base.nsPerSample;
+        }
+    }
+
+    const auto passed = costAt2x[0] < oversamplingBudget && costAt2x[1] < oversamplingBudget;
+
+    std::printf ("{\"iir_2x_cost\":%.3f,\"fir_2x_cost\":%.3f,\"budget\":%.3g,\"passed\":%s}\n",
+                 costAt2x[0], costAt2x[1], oversamplingBudget, passed ? "true" : "false");
+
+    return passed ? 0 : 1;
+}
+
+} // namespace
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    BenchConfig config;
+
+    if (! parseArguments (argc, argv, config))
+    {
+        printUsage();
+        return 1;
+    }
+
+    juce::ScopedNoDenormals noDenormals;
+
+    return config.doublePrecision ? runAll<double> (config) : runAll<float> (config);
+}
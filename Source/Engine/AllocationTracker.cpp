@@ -0,0 +1,89 @@
+/*
+  ==============================================================================
+
+    AllocationTracker.cpp
+    Debug-build guard against heap allocation on the audio thread.
+
+  ==============================================================================
+*/
+
+#include "AllocationTracker.h"
+
+#include <atomic>
+
+#if JAFFTUNE_TRACK_ALLOCATIONS
+ #include <cassert>
+ #include <cstdlib>
+ #include <new>
+#endif
+
+namespace jafftune
+{
+
+namespace
+{
+    thread_local int guardDepth = 0;
+    std::atomic<std::size_t> violationCount { 0 };
+}
+
+ScopedNoAllocation::ScopedNoAllocation() noexcept     { ++guardDepth; }
+ScopedNoAllocation::~ScopedNoAllocation() noexcept    { --guardDepth; }
+
+std::size_t ScopedNoAllocation::getViolationCount() noexcept
+{
+    return violationCount.load (std::memory_order_relaxed);
+}
+
+#if JAFFTUNE_TRACK_ALLOCATIONS
+namespace
+{
+    void* trackedAllocate (std::size_t size) noexcept
+    {
+        if (guardDepth > 0)
+        {
+            violationCount.fetch_add (1, std::memory_order_relaxed);
+
+            //lift the guard so whatever the assertion handler allocates isn't reported again
+            const auto depth = guardDepth;
+            guardDepth = 0;
+            assert (! "heap allocation inside a jafftune::ScopedNoAllocation scope");
+            guardDepth = depth;
+        }
+
+        return std::malloc (size == 0 ? 1 : size);
+    }
+}
+#endif
+
+} // namespace jafftune
+
+#if JAFFTUNE_TRACK_ALLOCATIONS
+//==============================================================================
+// Replacements for the global (non-aligned) allocation functions. Aligned
+// allocations keep the library's own implementation and pairing.
+void* operator new (std::size_t size)
+{
+    if (auto* p = jafftune::trackedAllocate (size))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size)
+{
+    if (auto* p = jafftune::trackedAllocate (size))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept      { return jafftune::trackedAllocate (size); }
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept    { return jafftune::trackedAllocate (size); }
+
+void operator delete (void* p) noexcept                                     { std::free (p); }
+void operator delete[] (void* p) noexcept                                   { std::free (p); }
+void operator delete (void* p, std::size_t) noexcept                        { std::free (p); }
+void operator delete[] (void* p, std::size_t) noexcept                      { std::free (p); }
+void operator delete (void* p, const std::nothrow_t&) noexcept              { std::free (p); }
+void operator delete[] (void* p, const std::nothrow_t&) noexcept            { std::free (p); }
+#endif
@@ -0,0 +1,57 @@
+/*
+  ==============================================================================
+
+    AllocationTracker.h
+    Debug-build guard against heap allocation on the audio thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstddef>
+
+namespace jafftune
+{
+
+//==============================================================================
+/**
+    While one of these is alive, any operator new on the same thread is a bug.
+
+    In builds with JAFFTUNE_TRACK_ALLOCATIONS (Debug by default) the engine
+    library replaces the global operator new, counts every allocation made
+    inside a guarded scope and asserts. In other builds the guard compiles to
+    nothing.
+
+    @code
+    void processBlock (...)
+    {
+        jafftune::ScopedNoAllocation noAllocation;
+        ...
+    }
+    @endcode
+*/
+class ScopedNoAllocation
+{
+public:
+    ScopedNoAllocation() noexcept;
+    ~ScopedNoAllocation() noexcept;
+
+    /** Number of allocations caught inside any guarded scope, on any thread. */
+    static std::size_t getViolationCount() noexcept;
+
+    /** True if this build replaces operator new to track allocations. */
+    static constexpr bool isTracking() noexcept
+    {
+       #if JAFFTUNE_TRACK_ALLOCATIONS
+        return true;
+       #else
+        return false;
+       #endif
+    }
+
+    ScopedNoAllocation (const ScopedNoAllocation&) = delete;
+    ScopedNoAllocation& operator= (const ScopedNoAllocation&) = delete;
+};
+
+} // namespace jafftune
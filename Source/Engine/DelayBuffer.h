@@ -0,0 +1,175 @@
+/*
+  ==============================================================================
+
+    DelayBuffer.h
+    Power-of-two circular buffer with block writes and batched grain reads.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+namespace jafftune
+{
+
+//==============================================================================
+/** How fractional delays are read from a DelayBuffer. */
+enum class Interpolation
+{
+    linear = 0,     // 2 points, matches juce::dsp::DelayLineInterpolationTypes::Linear
+    hermite         // 4-point, 3rd-order Hermite; less high-frequency loss on upward shifts
+};
+
+//==============================================================================
+/** Reads one interpolated tap delayInSamples behind index newest of a
+    power-of-two ring. Shared by DelayBuffer and StreamBank, so every history
+    the shifter reads from is interpolated identically.
+*/
+template <Interpolation interpolation, typename SampleType>
+SampleType readDelayTap (const SampleType* data, int mask, int newest, float delayInSamples) noexcept
+{
+    if constexpr (interpolation == Interpolation::linear)
+    {
+        const auto delayInt = (int) delayInSamples;
+        const auto frac = (SampleType) (delayInSamples - (float) delayInt);
+        const auto y0 = data[(newest - delayInt) & mask];
+        const auto y1 = data[(newest - delayInt - 1) & mask];
+        return y0 + frac * (y1 - y0);
+    }
+    else
+    {
+        //the newer neighbour of a sub-sample delay would be in the future, so
+        //Hermite taps never come closer than one sample
+        const auto delay = std::max (1.0f, delayInSamples);
+        const auto delayInt = (int) delay;
+        const auto t = (SampleType) (delay - (float) delayInt);
+        const auto index = newest - delayInt;
+
+        const auto ym1 = data[(index + 1) & mask];
+        const auto y0  = data[index & mask];
+        const auto y1  = data[(index - 1) & mask];
+        const auto y2  = data[(index - 2) & mask];
+
+        const auto c1 = SampleType (0.5) * (y1 - ym1);
+        const auto c2 = ym1 - SampleType (2.5) * y0 + SampleType (2) * y1 - SampleType (0.5) * y2;
+        const auto c3 = SampleType (0.5) * (y2 - ym1) + SampleType (1.5) * (y0 - y1);
+        return ((c3 * t + c2) * t + c1) * t + y0;
+    }
+}
+
+//==============================================================================
+/**
+    Multichannel input history for the pitch shifter.
+
+    Channels are stored planar in one contiguous allocation, each with a
+    power-of-two capacity so wrapping is a mask rather than a branch. A block
+    is written first and then read back as a whole: sample i of the block
+    sees the block's own sample i at delay 0.
+
+    Samples are stored and interpolated as SampleType (float or double); the
+    delays and tap gains are control signals and always come in as float.
+*/
+template <typename SampleType>
+class DelayBuffer
+{
+public:
+    //==============================================================================
+    DelayBuffer() = default;
+
+    /** Allocates room for at least minimumCapacity samples per channel. Not real-time safe. */
+    void prepare (int newNumChannels, int minimumCapacity)
+    {
+        capacity = 1;
+        while (capacity < minimumCapacity)
+            capacity <<= 1;
+
+        mask = capacity - 1;
+        numChannels = std::max (1, newNumChannels);
+        storage.assign ((size_t) (numChannels * capacity), SampleType (0));
+        writePosition = 0;
+    }
+
+    void reset() noexcept
+    {
+        std::fill (storage.begin(), storage.end(), SampleType (0));
+        writePosition = 0;
+    }
+
+    int getNumChannels() const noexcept     { return numChannels; }
+    int getCapacity() const noexcept        { return capacity; }
+
+    //==============================================================================
+    /** Copies a block into the channel's history, starting at the write position. */
+    void write (int channel, const SampleType* source, int numSamples) noexcept
+    {
+        auto* data = channelData (channel);
+        const auto firstPart = std::min (numSamples, capacity - writePosition);
+
+        std::copy (source, source + firstPart, data + writePosition);
+        std::copy (source + firstPart, source + numSamples, data);
+    }
+
+    /** Moves the write position past a block once every channel has been written and read. */
+    void advance (int numSamples) noexcept
+    {
+        writePosition = (writePosition + numSamples) & mask;
+    }
+
+    //==============================================================================
+    /** Reads two windowed taps per sample for the block just written:
+        dest[i] = tap (delayOne[i]) * gainOne[i] + tap (delayTwo[i]) * gainTwo[i].
+    */
+    template <Interpolation interpolation>
+    void readGrainPair (int channel, const float* delayOne, const float* gainOne,
+                        const float* delayTwo, const float* gainTwo,
+                        SampleType* dest, int numSamples) const noexcept
+    {
+        const auto* data = channelData (channel);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto newest = writePosition + i;
+            dest[i] = readTap<interpolation> (data, newest, delayOne[i]) * gainOne[i]
+                    + readTap<interpolation> (data, newest, delayTwo[i]) * gainTwo[i];
+        }
+    }
+
+    /** Copies the history delayInSamples (whole samples) behind each sample of the block just written. */
+    void readDelayed (int channel, int delayInSamples, SampleType* dest, int numSamples) const noexcept
+    {
+        const auto* data = channelData (channel);
+
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] = data[(writePosition + i - delayInSamples) & mask];
+    }
+
+    /** Reads one tap for sample sampleInBlock of the block just written. */
+    template <Interpolation interpolation>
+    SampleType read (int channel, int sampleInBlock, float delayInSamples) const noexcept
+    {
+        return readTap<interpolation> (channelData (channel), writePosition + sampleInBlock, delayInSamples);
+    }
+
+private:
+    //==============================================================================
+    SampleType* channelData (int channel) noexcept              { return storage.data() + (size_t) channel * (size_t) capacity; }
+    const SampleType* channelData (int channel) const noexcept  { return storage.data() + (size_t) channel * (size_t) capacity; }
+
+    template <Interpolation interpolation>
+    SampleType readTap (const SampleType* data, int newest, float delayInSamples) const noexcept
+    {
+        return readDelayTap<interpolation> (data, mask, newest, delayInSamples);
+    }
+
+    //==============================================================================
+    std::vector<SampleType> storage;
+    int numChannels = 0;
+    int capacity = 0;
+    int mask = 0;
+    int writePosition = 0;
+};
+
+} // namespace jafftune
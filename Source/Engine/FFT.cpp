@@ -0,0 +1,164 @@
+/*
+  ==============================================================================
+
+    FFT.cpp
+    Radix-2 real FFT whose work can be run one stage at a time.
+
+  ==============================================================================
+*/
+
+#include "FFT.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace jafftune
+{
+
+namespace
+{
+    constexpr double twoPi = 6.283185307179586476925;
+
+    //complex multiply without std::complex's NaN and infinity handling
+    inline FFT::Complex multiply (FFT::Complex a, FFT::Complex b) noexcept
+    {
+        return { a.real() * b.real() - a.imag() * b.imag(),
+                 a.real() * b.imag() + a.imag() * b.real() };
+    }
+}
+
+//==============================================================================
+void FFT::prepare (int newOrder)
+{
+    order = std::max (2, newOrder);
+    size = 1 << order;
+
+    const auto half = size / 2;
+
+    twiddles.resize ((size_t) half);
+    for (int k = 0; k < half; ++k)
+        twiddles[(size_t) k] = { (float) std::cos (twoPi * k / half), (float) -std::sin (twoPi * k / half) };
+
+    splitTwiddles.resize ((size_t) half + 1);
+    for (int k = 0; k <= half; ++k)
+        splitTwiddles[(size_t) k] = { (float) std::cos (twoPi * k / size), (float) -std::sin (twoPi * k / size) };
+
+    bitReversal.resize ((size_t) half);
+    for (int i = 0; i < half; ++i)
+    {
+        int reversed = 0;
+
+        for (int bit = 0; bit < order - 1; ++bit)
+            reversed |= ((i >> bit) & 1) << (order - 2 - bit);
+
+        bitReversal[(size_t) i] = reversed;
+    }
+}
+
+//==============================================================================
+void FFT::performRealForward (const float* input, Complex* spectrum, Complex* work) const noexcept
+{
+    packForward (input, work);
+
+    for (int pass = 0; pass < getNumPasses(); ++pass)
+        performPass (work, pass, false);
+
+    unpackForward (work, spectrum);
+}
+
+void FFT::performRealInverse (const Complex* spectrum, float* output, Complex* work) const noexcept
+{
+    packInverse (spectrum, work);
+
+    for (int pass = 0; pass < getNumPasses(); ++pass)
+        performPass (work, pass, true);
+
+    unpackInverse (work, output);
+}
+
+//==============================================================================
+void FFT::packForward (const float* input, Complex* work) const noexcept
+{
+    //even samples become the real parts and odd ones the imaginary parts, in bit-reversed order
+    const auto half = size / 2;
+
+    for (int n = 0; n < half; ++n)
+        work[bitReversal[(size_t) n]] = { input[2 * n], input[2 * n + 1] };
+}
+
+void FFT::unpackForward (const Complex* work, Complex* spectrum) const noexcept
+{
+    //split the half-size transform Z into the even- and odd-sample transforms and recombine:
+    //X[k] = (Z[k] + Z*[N/2 - k]) / 2 - i e^(-2 pi i k / N) (Z[k] - Z*[N/2 - k]) / 2
+    const auto half = size / 2;
+
+    for (int k = 0; k <= half; ++k)
+    {
+        const auto z = work[k == half ? 0 : k];
+        const auto mirror = std::conj (work[k == 0 ? 0 : half - k]);
+
+        const Complex even = (z + mirror) * 0.5f;
+        const Complex difference = (z - mirror) * 0.5f;
+        const Complex odd { difference.imag(), -difference.real() };    // difference / i
+
+        spectrum[k] = even + multiply (splitTwiddles[(size_t) k], odd);
+    }
+}
+
+void FFT::packInverse (const Complex* spectrum, Complex* work) const noexcept
+{
+    //undo unpackForward, then scatter into bit-reversed order for the passes
+    const auto half = size / 2;
+    const auto scale = 1.0f / (float) size;
+
+    for (int k = 0; k < half; ++k)
+    {
+        const auto x = spectrum[k];
+        const auto mirror = std::conj (spectrum[half - k]);
+
+        const Complex even = x + mirror;
+        const Complex odd = multiply (x - mirror, std::conj (splitTwiddles[(size_t) k]));
+
+        //Z = even + i odd, scaled so the inverse is normalised
+        work[bitReversal[(size_t) k]] = Complex { even.real() - odd.imag(), even.imag() + odd.real() } * scale;
+    }
+}
+
+void FFT::unpackInverse (const Complex* work, float* output) const noexcept
+{
+    const auto half = size / 2;
+
+    for (int n = 0; n < half; ++n)
+    {
+        output[2 * n] = work[n].real();
+        output[2 * n + 1] = work[n].imag();
+    }
+}
+
+//==============================================================================
+void FFT::performPass (Complex* work, int pass, bool inverse) const noexcept
+{
+    const auto half = size / 2;
+    const auto span = 1 << pass;                // butterfly distance
+    const auto twiddleStride = half / (2 * span);
+
+    for (int group = 0; group < half; group += 2 * span)
+    {
+        for (int k = 0; k < span; ++k)
+        {
+            auto w = twiddles[(size_t) (k * twiddleStride)];
+
+            if (inverse)
+                w = std::conj (w);
+
+            auto& a = work[group + k];
+            auto& b = work[group + k + span];
+            const auto t = multiply (w, b);
+
+            b = a - t;
+            a = a + t;
+        }
+    }
+}
+
+} // namespace jafftune
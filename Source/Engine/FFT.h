@@ -0,0 +1,77 @@
+/*
+  ==============================================================================
+
+    FFT.h
+    Radix-2 real FFT whose work can be run one stage at a time.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <complex>
+#include <vector>
+
+namespace jafftune
+{
+
+//==============================================================================
+/**
+    Real-input FFT of a power-of-two size, computed as a half-size complex
+    transform plus a split step, with all tables built in prepare().
+
+    Besides the one-shot performRealForward() and performRealInverse(), the
+    transform is exposed as its separate stages (pack, each butterfly pass,
+    unpack) so a caller can spread one transform across several audio
+    blocks instead of paying for it all at once. The inverse is normalised,
+    so forward then inverse gives back the input.
+*/
+class FFT
+{
+public:
+    //==============================================================================
+    using Complex = std::complex<float>;
+
+    FFT() = default;
+
+    /** Builds the twiddle and bit-reversal tables for 2^order real samples. Not real-time safe. */
+    void prepare (int newOrder);
+
+    int getOrder() const noexcept           { return order; }
+    int getSize() const noexcept            { return size; }
+
+    /** Number of butterfly passes in each direction. */
+    int getNumPasses() const noexcept       { return order - 1; }
+
+    //==============================================================================
+    /** Transforms getSize() real samples into getSize() / 2 + 1 bins, using
+        getSize() / 2 complex values of work space.
+    */
+    void performRealForward (const float* input, Complex* spectrum, Complex* work) const noexcept;
+
+    /** Transforms getSize() / 2 + 1 bins back into getSize() real samples. */
+    void performRealInverse (const Complex* spectrum, float* output, Complex* work) const noexcept;
+
+    //==============================================================================
+    /** The stages of performRealForward(): packForward(), every pass in order, unpackForward(). */
+    void packForward (const float* input, Complex* work) const noexcept;
+    void unpackForward (const Complex* work, Complex* spectrum) const noexcept;
+
+    /** The stages of performRealInverse(): packInverse(), every pass in order, unpackInverse(). */
+    void packInverse (const Complex* spectrum, Complex* work) const noexcept;
+    void unpackInverse (const Complex* work, float* output) const noexcept;
+
+    /** One butterfly pass of the half-size complex transform, 0 <= pass < getNumPasses(). */
+    void performPass (Complex* work, int pass, bool inverse) const noexcept;
+
+private:
+    //==============================================================================
+    int order = 0;
+    int size = 0;
+
+    std::vector<Complex> twiddles;      // e^(-2 pi i k / (size / 2)), for the complex passes
+    std::vector<Complex> splitTwiddles; // e^(-2 pi i k / size), for packing and unpacking
+    std::vector<int> bitReversal;
+};
+
+} // namespace jafftune
@@ -0,0 +1,158 @@
+/*
+  ==============================================================================
+
+    ParameterSmoother.h
+    Per-sample parameter ramps generated a block at a time.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "VectorOps.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace jafftune
+{
+
+//==============================================================================
+/** How a ParameterSmoother moves towards its target. */
+enum class SmoothingType
+{
+    linear = 0,         // equal steps; for gains that can reach 0
+    multiplicative      // equal ratios; for pitch ratios and dB-derived gains
+};
+
+//==============================================================================
+/**
+    Ramps a parameter to each new target over a fixed time, one value per sample.
+
+    Like juce::SmoothedValue, but the ramp for a whole block is written in one
+    go (vectorized for linear ramps), and fillRamp() reports when the value is
+    steady so callers can skip the per-sample arrays entirely.
+*/
+template <SmoothingType type>
+class ParameterSmoother
+{
+public:
+    //==============================================================================
+    ParameterSmoother() = default;
+
+    explicit ParameterSmoother (float initialValue) noexcept
+        : current (initialValue), target (initialValue) {}
+
+    /** Sets the ramp length and jumps to the target. */
+    void reset (double sampleRate, float rampLengthMs) noexcept
+    {
+        rampLengthInSamples = std::max (1, (int) std::lround (rampLengthMs * 0.001 * sampleRate));
+        setCurrentAndTarget (target);
+    }
+
+    /** Jumps straight to a value, abandoning any ramp. */
+    void setCurrentAndTarget (float newValue) noexcept
+    {
+        current = target = newValue;
+        countdown = 0;
+    }
+
+    /** Starts a ramp from the current value to newTarget. */
+    void setTarget (float newTarget) noexcept
+    {
+        if (newTarget == target)
+            return;
+
+        target = newTarget;
+
+        //a multiplicative ramp can't start or end at zero, so it jumps instead
+        if constexpr (type == SmoothingType::multiplicative)
+        {
+            if (current <= 0.0f || target <= 0.0f)
+            {
+                setCurrentAndTarget (target);
+                return;
+            }
+
+            step = std::pow (target / current, 1.0f / (float) rampLengthInSamples);
+        }
+        else
+        {
+            step = (target - current) / (float) rampLengthInSamples;
+        }
+
+        countdown = rampLengthInSamples;
+    }
+
+    float getCurrent() const noexcept       { return current; }
+    float getTarget() const noexcept        { return target; }
+    bool isSmoothing() const noexcept       { return countdown > 0; }
+
+    //==============================================================================
+    /** Advances one sample and returns the new value. */
+    float getNext() noexcept
+    {
+        if (countdown == 0)
+            return current;
+
+        if (--countdown == 0)
+            current = target;
+        else if constexpr (type == SmoothingType::multiplicative)
+            current *= step;
+        else
+            current += step;
+
+        return current;
+    }
+
+    /** Writes the next numSamples values to dest and returns true, or returns
+        false without touching dest if the value is steady for the whole
+        block, in which case getCurrent() holds it.
+    */
+    bool fillRamp (float* dest, int numSamples) noexcept
+    {
+        if (countdown == 0)
+            return false;
+
+        const auto numRamping = std::min (numSamples, countdown);
+        int i = 0;
+
+        if constexpr (type == SmoothingType::linear)
+        {
+            using simd::Vec;
+            const auto start = current;
+
+            for (; i + Vec::size <= numRamping; i += Vec::size)
+                Vec::ramp (start + step * (float) (i + 1), step).store (dest + i);
+
+            for (; i < numRamping; ++i)
+                dest[i] = start + step * (float) (i + 1);
+        }
+        else
+        {
+            auto value = current;
+
+            for (; i < numRamping; ++i)
+                dest[i] = value *= step;
+        }
+
+        countdown -= numRamping;
+        current = countdown == 0 ? target : dest[numRamping - 1];
+
+        //the last ramp value lands exactly on the target, and the rest of the block holds it
+        if (countdown == 0)
+            std::fill (dest + numRamping - 1, dest + numSamples, target);
+
+        return true;
+    }
+
+private:
+    //==============================================================================
+    float current = 0.0f;
+    float target = 0.0f;
+    float step = 0.0f;
+    int countdown = 0;
+    int rampLengthInSamples = 1;
+};
+
+} // namespace jafftune
@@ -0,0 +1,173 @@
+/*
+  ==============================================================================
+
+    PerformanceMonitor.cpp
+    Always-on timing of processBlock, summarised away from the audio thread.
+
+  ==============================================================================
+*/
+
+#include "PerformanceMonitor.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace jafftune
+{
+
+//==============================================================================
+void PerformanceMonitor::RollingHistogram::clear() noexcept
+{
+    std::fill (std::begin (counts), std::end (counts), 0);
+}
+
+void PerformanceMonitor::RollingHistogram::add (float value, int count) noexcept
+{
+    const auto octaves = value > lowest ? std::log2 ((double) value / lowest) : 0.0;
+    const auto bin = std::min (numBins - 1, (int) (octaves * binsPerOctave));
+
+    counts[bin] += count;
+}
+
+double PerformanceMonitor::RollingHistogram::getPercentile (double fraction, int total) const noexcept
+{
+    //upper edge of the bin the percentile falls in
+    const auto wanted = fraction * (double) total;
+    auto seen = 0;
+
+    for (int bin = 0; bin < numBins; ++bin)
+    {
+        seen += counts[bin];
+
+        if ((double) seen >= wanted)
+            return lowest * std::exp2 ((double) (bin + 1) / binsPerOctave);
+    }
+
+    return lowest * std::exp2 ((double) numBins / binsPerOctave);
+}
+
+//==============================================================================
+PerformanceMonitor::PerformanceMonitor()
+    : history ((size_t) historyLength)
+{
+    //a quarter of a microsecond up, and from a few thousandths of a percent of the deadline up
+    timeHistogram.lowest = 0.25;
+    loadHistogram.lowest = 1.0 / 65536.0;
+}
+
+void PerformanceMonitor::prepare (double sampleRate) noexcept
+{
+    secondsPerSample = 1.0 / sampleRate;
+    modeSwitches.store (0, std::memory_order_relaxed);
+    droppedBlocks.store (0, std::memory_order_relaxed);
+
+    //the reading thread may be mid-collect(), so it clears its own side
+    clearRequested.store (true, std::memory_order_release);
+}
+
+//==============================================================================
+void PerformanceMonitor::addBlock (Clock::duration elapsed, int numSamples) noexcept
+{
+    if (numSamples <= 0)
+        return;
+
+    const auto seconds = std::chrono::duration<double> (elapsed).count();
+    const BlockRecord record { (float) (seconds * 1.0e6), (float) (seconds / (numSamples * secondsPerSample)) };
+
+    if (! ring.push (record))
+        droppedBlocks.fetch_add (1, std::memory_order_relaxed);
+}
+
+void PerformanceMonitor::noteModeSwitch() noexcept
+{
+    modeSwitches.fetch_add (1, std::memory_order_relaxed);
+}
+
+//==============================================================================
+void PerformanceMonitor::clearHistory() noexcept
+{
+    BlockRecord discarded;
+
+    while (ring.pop (discarded)) {}
+
+    historyStart = 0;
+    historySize = 0;
+    timeHistogram.clear();
+    loadHistogram.clear();
+    totalBlocks = 0;
+    overruns = 0;
+}
+
+PerformanceStats PerformanceMonitor::collect() noexcept
+{
+    if (clearRequested.exchange (false, std::memory_order_acquire))
+        clearHistory();
+
+    //move the new blocks into the window, retiring the oldest from the histograms
+    BlockRecord record;
+
+    while (ring.pop (record))
+    {
+        if (historySize == historyLength)
+        {
+            const auto& oldest = history[(size_t) historyStart];
+            timeHistogram.add (oldest.microseconds, -1);
+            loadHistogram.add (oldest.load, -1);
+
+            historyStart = (historyStart + 1) % historyLength;
+            --historySize;
+        }
+
+        history[(size_t) ((historyStart + historySize) % historyLength)] = record;
+        ++historySize;
+
+        timeHistogram.add (record.microseconds, 1);
+        loadHistogram.add (record.load, 1);
+
+        ++totalBlocks;
+
+        if (record.load >= 1.0f)
+            ++overruns;
+    }
+
+    PerformanceStats stats;
+    stats.numBlocks = historySize;
+    stats.totalBlocks = totalBlocks;
+    stats.overruns = overruns;
+    stats.modeSwitches = modeSwitches.load (std::memory_order_relaxed);
+    stats.droppedBlocks = droppedBlocks.load (std::memory_order_relaxed);
+
+    if (historySize == 0)
+        return stats;
+
+    //exact extremes and means from the window itself; it is small, and this isn't the audio thread
+    auto minTime = history[(size_t) historyStart].microseconds;
+    auto maxTime = minTime;
+    auto maxLoad = 0.0f;
+    auto timeSum = 0.0;
+    auto loadSum = 0.0;
+
+    for (int i = 0; i < historySize; ++i)
+    {
+        const auto& block = history[(size_t) ((historyStart + i) % historyLength)];
+
+        minTime = std::min (minTime, block.microseconds);
+        maxTime = std::max (maxTime, block.microseconds);
+        maxLoad = std::max (maxLoad, block.load);
+        timeSum += block.microseconds;
+        loadSum += block.load;
+    }
+
+    stats.minMicroseconds = minTime;
+    stats.meanMicroseconds = timeSum / historySize;
+    stats.maxMicroseconds = maxTime;
+    stats.p99Microseconds = std::min ((double) maxTime, timeHistogram.getPercentile (0.99, historySize));
+
+    stats.meanLoad = loadSum / historySize;
+    stats.maxLoad = maxLoad;
+    stats.p99Load = std::min ((double) maxLoad, loadHistogram.getPercentile (0.99, historySize));
+
+    return stats;
+}
+
+} // namespace jafftune
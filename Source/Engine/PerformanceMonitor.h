@@ -0,0 +1,152 @@
+/*
+  ==============================================================================
+
+    PerformanceMonitor.h
+    Always-on timing of processBlock, summarised away from the audio thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "SpscRing.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace jafftune
+{
+
+//==============================================================================
+/** Summary of the most recent blocks, as returned by PerformanceMonitor::collect(). */
+struct PerformanceStats
+{
+    int numBlocks = 0;                  // blocks in the rolling window
+
+    double minMicroseconds = 0.0;
+    double meanMicroseconds = 0.0;
+    double p99Microseconds = 0.0;
+    double maxMicroseconds = 0.0;
+
+    //processing time over the block's real-time deadline: 1 means the block took as long as it lasts
+    double meanLoad = 0.0;
+    double p99Load = 0.0;
+    double maxLoad = 0.0;
+
+    std::uint64_t totalBlocks = 0;      // since prepare()
+    std::uint64_t overruns = 0;         // blocks that missed their deadline, since prepare()
+    std::uint32_t modeSwitches = 0;
+    std::uint32_t droppedBlocks = 0;    // timings lost because the reader fell behind
+};
+
+//==============================================================================
+/**
+    Times every audio block and keeps rolling statistics of the last
+    historyLength of them.
+
+    The audio thread only reads the clock twice and pushes one small record
+    into a wait-free ring, so this is cheap enough to leave on in release
+    builds. All the bookkeeping (the rolling window and its histograms) is
+    done by collect() on the reading thread.
+
+    @code
+    void processBlock (juce::AudioBuffer<float>& buffer, ...)
+    {
+        jafftune::PerformanceMonitor::ScopedBlockTimer timer (monitor, buffer.getNumSamples());
+        ...
+    }
+    @endcode
+*/
+class PerformanceMonitor
+{
+public:
+    //==============================================================================
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr int historyLength = 2048;
+
+    PerformanceMonitor();
+
+    /** Sets the rate the block deadlines are worked out at and clears the counters.
+        Call while the audio thread is stopped, e.g. from prepareToPlay().
+    */
+    void prepare (double sampleRate) noexcept;
+
+    //==============================================================================
+    /** Audio thread: records the time between its construction and destruction. */
+    class ScopedBlockTimer
+    {
+    public:
+        ScopedBlockTimer (PerformanceMonitor& monitorToUse, int numSamplesInBlock) noexcept
+            : monitor (monitorToUse), numSamples (numSamplesInBlock), start (Clock::now()) {}
+
+        ~ScopedBlockTimer() noexcept    { monitor.addBlock (Clock::now() - start, numSamples); }
+
+    private:
+        PerformanceMonitor& monitor;
+        int numSamples;
+        Clock::time_point start;
+
+        ScopedBlockTimer (const ScopedBlockTimer&) = delete;
+        ScopedBlockTimer& operator= (const ScopedBlockTimer&) = delete;
+    };
+
+    /** Audio thread: records one block that took elapsed to process. */
+    void addBlock (Clock::duration elapsed, int numSamples) noexcept;
+
+    /** Audio thread: counts a change of operation mode. */
+    void noteModeSwitch() noexcept;
+
+    //==============================================================================
+    /** Reading thread: takes in the blocks published since the last call and
+        summarises the rolling window. Only one thread may call this.
+    */
+    PerformanceStats collect() noexcept;
+
+private:
+    //==============================================================================
+    struct BlockRecord
+    {
+        float microseconds;
+        float load;
+    };
+
+    //log-spaced bins, eight per octave, so percentiles come out within ~9%
+    struct RollingHistogram
+    {
+        static constexpr int binsPerOctave = 8;
+        static constexpr int numBins = 24 * binsPerOctave;
+
+        void clear() noexcept;
+        void add (float value, int count) noexcept;
+        double getPercentile (double fraction, int total) const noexcept;
+
+        double lowest = 1.0;            // lower edge of the first bin; smaller values land in it
+        int counts[numBins] = {};
+    };
+
+    void clearHistory() noexcept;
+
+    //audio thread
+    SpscRing<BlockRecord, 1024> ring;
+    double secondsPerSample = 1.0 / 44100.0;
+    std::atomic<std::uint32_t> modeSwitches { 0 };
+    std::atomic<std::uint32_t> droppedBlocks { 0 };
+    std::atomic<bool> clearRequested { false };
+
+    //reading thread
+    std::vector<BlockRecord> history;
+    int historyStart = 0;
+    int historySize = 0;
+    RollingHistogram timeHistogram;
+    RollingHistogram loadHistogram;
+    std::uint64_t totalBlocks = 0;
+    std::uint64_t overruns = 0;
+
+    PerformanceMonitor (const PerformanceMonitor&) = delete;
+    PerformanceMonitor& operator= (const PerformanceMonitor&) = delete;
+};
+
+} // namespace jafftune
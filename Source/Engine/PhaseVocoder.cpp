@@ -0,0 +1,669 @@
+/*
+  ==============================================================================
+
+    PhaseVocoder.cpp
+    Phase-locked FFT pitch shifter with an evenly spread frame workload.
+
+  ==============================================================================
+*/
+
+#include "PhaseVocoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace jafftune
+{
+
+namespace
+{
+    constexpr float pi = 3.14159265358979323846f;
+    constexpr float twoPi = 2.0f * pi;
+
+    //frame length of each VocoderQuality, rounded to a power of two at the sample rate
+    constexpr double frameLengthsMs[] = { 20.0, 40.0, 80.0 };
+
+    //analysis and peak shifting work through this many bins per unit
+    constexpr int sliceBins = 256;
+
+    //measured cost of each stage relative to one FFT pass, for spreading a frame evenly over its hop
+    constexpr float windowAndPackCost = 2.0f;
+    constexpr float passCost = 1.0f;
+    constexpr float unpackCost = 3.5f;
+    constexpr float analyseSliceCost = 2.5f;
+    constexpr float findPeaksCost = 2.0f;
+    constexpr float shiftSliceCost = 1.5f;
+    constexpr float shiftSliceFormantCost = 3.0f;
+    constexpr float packInverseCost = 2.5f;
+    constexpr float overlapAddCost = 2.5f;
+    constexpr float envelopeLogCost = 1.5f;
+    constexpr float envelopeTransformCost = 2.0f;
+    constexpr float envelopeLifterCost = 0.5f;
+    constexpr float envelopeStoreCost = 4.0f;
+
+    //the envelope is found from every fourth bin, on every other frame, and reused in between
+    constexpr int envelopeDecimation = 4;
+    constexpr int envelopeInterval = 2;
+
+    //cepstral coefficients up to this quefrency make up the envelope; above it lie the harmonics
+    //of anything pitched below ~650 Hz
+    constexpr double lifterCutoffMs = 1.5;
+
+    //most the envelope correction may lift a bin (+30 dB), so shifting quiet bins into a formant
+    //doesn't blow up their noise
+    constexpr float maxFormantBoost = 31.6f;
+
+    //the log spectrum is floored this far below the frame's loudest bin (-50 dB), so gaps between
+    //sparse partials don't carve deep valleys into the envelope and wipe out what's shifted into them
+    constexpr float envelopeFloor = 3.0e-3f;
+    constexpr float silentMagnitude = 1.0e-9f;
+
+    //peaks quieter than this, relative to the loudest bin, are left with their neighbours (-80 dB)
+    constexpr float peakFloor = 1.0e-4f;
+
+    //sum of the squared Hann windows at four times overlap
+    constexpr float overlapAddGain = 1.5f;
+
+    inline float wrapPhase (float phase) noexcept
+    {
+        return phase - twoPi * std::round (phase / twoPi);
+    }
+
+    //atan2 to within 2e-6 radians from a minimax polynomial, several times faster than std::atan2
+    inline float fastAtan2 (float y, float x) noexcept
+    {
+        const auto ax = std::abs (x);
+        const auto ay = std::abs (y);
+        const auto a = std::min (ax, ay) / std::max (std::max (ax, ay), 1.0e-30f);
+        const auto s = a * a;
+
+        auto angle = ((((((-0.01172120f * s + 0.05265332f) * s - 0.11643287f) * s + 0.19354346f) * s
+                         - 0.33262347f) * s + 0.99997726f) * a);
+
+        angle = ay > ax ? 0.5f * pi - angle : angle;
+        angle = x < 0.0f ? pi - angle : angle;
+        return y < 0.0f ? -angle : angle;
+    }
+
+    int frameOrder (double sampleRate, VocoderQuality quality)
+    {
+        const auto samples = sampleRate * frameLengthsMs[(int) quality] * 0.001;
+        return std::max (8, (int) std::lround (std::log2 (samples)));
+    }
+}
+
+//==============================================================================
+void PhaseVocoder::prepare (double newSampleRate, int numChannels)
+{
+    sampleRate = newSampleRate;
+
+    for (int q = 0; q < (int) VocoderQuality::numQualities; ++q)
+    {
+        auto& table = ffts[q];
+        table.prepare (frameOrder (sampleRate, (VocoderQuality) q));
+        envelopeFfts[q].prepare (table.getOrder() - 2);
+
+        //periodic Hann, so four overlapping squared windows sum to a constant
+        const auto size = table.getSize();
+        windows[q].resize ((size_t) size);
+
+        for (int i = 0; i < size; ++i)
+            windows[q][(size_t) i] = 0.5f - 0.5f * std::cos (twoPi * (float) i / (float) size);
+    }
+
+    //the rings hold a frame plus a hop of history (and the dry delay), or a frame and a hop of output ahead
+    const auto largestFrame = ffts[(int) VocoderQuality::highQuality].getSize();
+    const auto ringSize = 2 * largestFrame;
+    const auto largestBins = largestFrame / 2 + 1;
+    const auto largestEnvelope = envelopeFfts[(int) VocoderQuality::highQuality].getSize();
+
+    ringMask = ringSize - 1;
+    channels.resize ((size_t) std::max (1, numChannels));
+
+    for (auto& channel : channels)
+    {
+        channel.input.assign ((size_t) ringSize, 0.0f);
+        channel.output.assign ((size_t) ringSize, 0.0f);
+        channel.frame.assign ((size_t) largestFrame, 0.0f);
+        channel.work.assign ((size_t) largestFrame / 2, {});
+        channel.spectrum.assign ((size_t) largestBins, {});
+        channel.magnitude.assign ((size_t) largestBins, 0.0f);
+        channel.phase.assign ((size_t) largestBins, 0.0f);
+        channel.frequency.assign ((size_t) largestBins, 0.0f);
+        channel.lastPhase.assign ((size_t) largestBins, 0.0f);
+        channel.regionPeak.assign ((size_t) largestBins, 0);
+        channel.nextRegionPeak.assign ((size_t) largestBins, 0);
+        channel.peakPhase.assign ((size_t) largestBins, 0.0f);
+        channel.nextPeakPhase.assign ((size_t) largestBins, 0.0f);
+        channel.envelopeSpectrum.assign ((size_t) largestEnvelope / 2 + 1, {});
+        channel.envelopeWork.assign ((size_t) largestEnvelope / 2, {});
+        channel.cepstrum.assign ((size_t) largestEnvelope, 0.0f);
+        channel.envelope.assign ((size_t) largestBins, 1.0f);
+    }
+
+    peaks.assign ((size_t) largestBins, 0);
+
+    //every quality's unit list fits: two sets of passes, two sets of slices and the fixed and envelope stages
+    const auto largestSlices = (largestBins + sliceBins - 1) / sliceBins;
+    sliceFirstPeak.assign ((size_t) largestSlices + 1, 0);
+    units.reserve ((size_t) (2 * ffts[(int) VocoderQuality::highQuality].getNumPasses() + 2 * largestSlices + 11));
+
+    configure (quality);
+}
+
+void PhaseVocoder::release()
+{
+    //a new vocoder owns nothing, so taking its place frees the tables and rings
+    PhaseVocoder released;
+    released.sampleRate = sampleRate;
+    released.quality = quality;
+    released.pitchRatio = pitchRatio;
+    released.preserveFormants = preserveFormants;
+    released.formantRatio = formantRatio;
+    *this = std::move (released);
+}
+
+void PhaseVocoder::reset() noexcept
+{
+    configure (quality);
+}
+
+void PhaseVocoder::setQuality (VocoderQuality newQuality) noexcept
+{
+    if (newQuality != quality)
+        configure (newQuality);
+}
+
+void PhaseVocoder::setFormantPreservation (bool shouldPreserve, float newFormantRatio) noexcept
+{
+    preserveFormants = shouldPreserve;
+    formantRatio = newFormantRatio;
+}
+
+void PhaseVocoder::configure (VocoderQuality newQuality) noexcept
+{
+    quality = newQuality;
+
+    if (channels.empty())
+        return;
+
+    fft = &ffts[(int) quality];
+    envelopeFft = &envelopeFfts[(int) quality];
+    window = windows[(int) quality].data();
+    frameSize = fft->getSize();
+    hopSize = frameSize / overlap;
+    numBins = frameSize / 2 + 1;
+    numSlices = (numBins + sliceBins - 1) / sliceBins;
+
+    //the envelope's quefrencies are in samples whatever the decimation, but only half its transform is usable
+    liftering = std::min (envelopeFft->getSize() / 2 - 1, (int) std::lround (sampleRate * lifterCutoffMs * 0.001));
+
+    for (auto& channel : channels)
+    {
+        std::fill (channel.input.begin(), channel.input.end(), 0.0f);
+        std::fill (channel.output.begin(), channel.output.end(), 0.0f);
+        std::fill (channel.lastPhase.begin(), channel.lastPhase.end(), 0.0f);
+        std::fill (channel.peakPhase.begin(), channel.peakPhase.end(), 0.0f);
+        std::fill (channel.envelope.begin(), channel.envelope.end(), 1.0f);
+
+        for (int k = 0; k < numBins; ++k)
+            channel.regionPeak[(size_t) k] = k;
+    }
+
+    framePreservesFormants = false;
+    buildUnits (false);
+
+    //idle until the first hop has been written
+    writePosition = 0;
+    hopPosition = 0;
+    frameChannels = 0;
+    nextUnit = 0;
+    frameCount = 0;
+}
+
+void PhaseVocoder::buildUnits (bool withEnvelope) noexcept
+{
+    //one channel's stages in order, each with the cost of the ones before it
+    units.clear();
+    auto cost = 0.0f;
+
+    auto addUnit = [&] (Stage stage, int index, float unitCost)
+    {
+        units.push_back ({ stage, index, cost });
+        cost += unitCost;
+    };
+
+    addUnit (Stage::windowAndPack, 0, windowAndPackCost);
+
+    for (int pass = 0; pass < fft->getNumPasses(); ++pass)
+        addUnit (Stage::forwardPass, pass, passCost);
+
+    addUnit (Stage::unpack, 0, unpackCost);
+
+    for (int slice = 0; slice < numSlices; ++slice)
+        addUnit (Stage::analyse, slice, analyseSliceCost);
+
+    if (withEnvelope)
+    {
+        addUnit (Stage::envelopeLog, 0, envelopeLogCost);
+        addUnit (Stage::envelopeInverse, 0, envelopeTransformCost);
+        addUnit (Stage::envelopeLifter, 0, envelopeLifterCost);
+        addUnit (Stage::envelopeForward, 0, envelopeTransformCost);
+        addUnit (Stage::envelopeStore, 0, envelopeStoreCost);
+    }
+
+    addUnit (Stage::findPeaks, 0, findPeaksCost);
+
+    for (int slice = 0; slice < numSlices; ++slice)
+        addUnit (Stage::shiftPeaks, slice, framePreservesFormants ? shiftSliceFormantCost : shiftSliceCost);
+
+    addUnit (Stage::packInverse, 0, packInverseCost);
+
+    for (int pass = 0; pass < fft->getNumPasses(); ++pass)
+        addUnit (Stage::inversePass, pass, passCost);
+
+    addUnit (Stage::overlapAdd, 0, overlapAddCost);
+    channelCost = cost;
+}
+
+//==============================================================================
+void PhaseVocoder::process (float* const* io, float* const* wet, int numChannels, int numSamples) noexcept
+{
+    if (fft == nullptr)
+        return;
+
+    numChannels = std::min (numChannels, (int) channels.size());
+    const auto latency = getLatencyInSamples();
+
+    for (int start = 0; start < numSamples;)
+    {
+        //never cross a hop boundary, where the next frame starts
+        const auto numThisTime = std::min (numSamples - start, hopSize - hopPosition);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto& channel = channels[(size_t) ch];
+            auto* input = channel.input.data();
+            auto* output = channel.output.data();
+            auto* dry = io[ch] + start;
+            auto* shifted = wet[ch] + start;
+
+            for (int i = 0; i < numThisTime; ++i)
+            {
+                const auto position = (writePosition + i) & ringMask;
+
+                input[position] = dry[i];
+                dry[i] = input[(position - latency) & ringMask];
+                shifted[i] = output[position];
+                output[position] = 0.0f;
+            }
+        }
+
+        writePosition = (writePosition + numThisTime) & ringMask;
+        hopPosition += numThisTime;
+        start += numThisTime;
+
+        //keep the frame's work in step with the hop, so every block does its share
+        runWork (channelCost * (float) frameChannels * (float) hopPosition / (float) hopSize);
+
+        if (hopPosition == hopSize)
+        {
+            runWork (channelCost * (float) frameChannels);
+            startFrame (numChannels);
+        }
+    }
+}
+
+void PhaseVocoder::writeInput (int channel, const float* input, int numSamples) noexcept
+{
+    if (fft == nullptr || channel >= (int) channels.size())
+        return;
+
+    auto& target = channels[(size_t) channel];
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const auto position = (writePosition + i) & ringMask;
+        target.input[(size_t) position] = input[i];
+        target.output[(size_t) position] = 0.0f;
+    }
+}
+
+void PhaseVocoder::startFrame (int numChannels) noexcept
+{
+    frameEnd = writePosition;
+    frameChannels = numChannels;
+    nextUnit = 0;
+    hopPosition = 0;
+
+    //a new envelope on every envelopeInterval-th frame; the frames between reuse the last one
+    framePreservesFormants = preserveFormants;
+    framePitchRatio = pitchRatio;
+    frameFormantRatio = formantRatio;
+    buildUnits (framePreservesFormants && frameCount % envelopeInterval == 0);
+    frameCount = (frameCount + 1) % envelopeInterval;
+}
+
+void PhaseVocoder::runWork (float target) noexcept
+{
+    const auto unitsPerChannel = (int) units.size();
+    const auto numUnits = unitsPerChannel * frameChannels;
+
+    while (nextUnit < numUnits)
+    {
+        const auto ch = nextUnit / unitsPerChannel;
+        const auto& unit = units[(size_t) (nextUnit % unitsPerChannel)];
+
+        //a unit runs once the hop has reached the point where it starts
+        if (channelCost * (float) ch + unit.costBefore >= target)
+            return;
+
+        runUnit (channels[(size_t) ch], unit);
+        ++nextUnit;
+    }
+}
+
+void PhaseVocoder::runUnit (Channel& channel, const WorkUnit& unit) noexcept
+{
+    switch (unit.stage)
+    {
+        case Stage::windowAndPack:
+        {
+            //the frame is the frameSize samples before frameEnd, still intact in the ring
+            const auto* input = channel.input.data();
+            auto* frame = channel.frame.data();
+            const auto first = frameEnd - frameSize;
+
+            for (int i = 0; i < frameSize; ++i)
+                frame[i] = input[(first + i) & ringMask] * window[i];
+
+            fft->packForward (frame, channel.work.data());
+            break;
+        }
+
+        case Stage::forwardPass:    fft->performPass (channel.work.data(), unit.index, false); break;
+        case Stage::unpack:         fft->unpackForward (channel.work.data(), channel.spectrum.data()); break;
+        case Stage::analyse:        analyse (channel, unit.index); break;
+        case Stage::envelopeLog:
+        case Stage::envelopeInverse:
+        case Stage::envelopeLifter:
+        case Stage::envelopeForward:
+        case Stage::envelopeStore:  runEnvelopeUnit (channel, unit.stage); break;
+        case Stage::findPeaks:      findPeaks (channel); break;
+        case Stage::shiftPeaks:     shiftPeaks (channel, unit.index); break;
+        case Stage::packInverse:    fft->packInverse (channel.spectrum.data(), channel.work.data()); break;
+        case Stage::inversePass:    fft->performPass (channel.work.data(), unit.index, true); break;
+
+        case Stage::overlapAdd:
+        {
+            //lands a hop after the frame's end, which the output hasn't reached yet
+            auto* frame = channel.frame.data();
+            auto* output = channel.output.data();
+            const auto first = frameEnd + hopSize;
+            const auto gain = 1.0f / overlapAddGain;
+
+            fft->unpackInverse (channel.work.data(), frame);
+
+            for (int i = 0; i < frameSize; ++i)
+                output[(first + i) & ringMask] += frame[i] * window[i] * gain;
+
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+//==============================================================================
+void PhaseVocoder::analyse (Channel& channel, int slice) noexcept
+{
+    const auto* spectrum = channel.spectrum.data();
+    auto* magnitude = channel.magnitude.data();
+    auto* phase = channel.phase.data();
+    auto* frequency = channel.frequency.data();
+    auto* lastPhase = channel.lastPhase.data();
+
+    //phase a bin's centre frequency advances by over one hop
+    const auto binAdvance = twoPi * (float) hopSize / (float) frameSize;
+    const auto deviationToBins = 1.0f / binAdvance;
+    const auto end = std::min (numBins, (slice + 1) * sliceBins);
+
+    for (int k = slice * sliceBins; k < end; ++k)
+    {
+        const auto re = spectrum[k].real();
+        const auto im = spectrum[k].imag();
+
+        magnitude[k] = std::sqrt (re * re + im * im);
+        phase[k] = fastAtan2 (im, re);
+
+        const auto deviation = wrapPhase (phase[k] - lastPhase[k] - binAdvance * (float) k);
+        frequency[k] = (float) k + deviation * deviationToBins;
+        lastPhase[k] = phase[k];
+    }
+}
+
+void PhaseVocoder::findPeaks (Channel& channel) noexcept
+{
+    const auto* magnitude = channel.magnitude.data();
+    const auto lastBin = numBins - 1;
+
+    //peaks: louder than two bins either side
+    auto loudest = 0.0f;
+
+    for (int k = 0; k < numBins; ++k)
+        loudest = std::max (loudest, magnitude[k]);
+
+    const auto floor = loudest * peakFloor;
+    numPeaks = 0;
+
+    for (int k = 2; k < lastBin - 1; ++k)
+    {
+        const auto m = magnitude[k];
+
+        if (m > floor && m > magnitude[k - 1] && m >= magnitude[k + 1] && m > magnitude[k - 2] && m >= magnitude[k + 2])
+            peaks[(size_t) numPeaks++] = k;
+    }
+
+    //each peak owns the bins up to halfway to its neighbours; with no peaks (silence) every bin is its own region
+    if (numPeaks == 0)
+    {
+        for (int k = 0; k < numBins; ++k)
+            channel.nextRegionPeak[(size_t) k] = k;
+    }
+
+    for (int p = 0; p < numPeaks; ++p)
+    {
+        const auto peak = peaks[(size_t) p];
+        const auto regionStart = p == 0 ? 0 : (peaks[(size_t) p - 1] + peak) / 2 + 1;
+        const auto regionEnd = p == numPeaks - 1 ? lastBin : (peak + peaks[(size_t) p + 1]) / 2;
+
+        for (int k = regionStart; k <= regionEnd; ++k)
+            channel.nextRegionPeak[(size_t) k] = peak;
+    }
+
+    //the shifting is done a slice of bins at a time, by where each peak sits
+    int p = 0;
+
+    for (int slice = 0; slice <= numSlices; ++slice)
+    {
+        while (p < numPeaks && peaks[(size_t) p] < slice * sliceBins)
+            ++p;
+
+        sliceFirstPeak[(size_t) slice] = p;
+    }
+
+    sliceFirstPeak[(size_t) numSlices] = numPeaks;
+    std::fill (channel.spectrum.begin(), channel.spectrum.begin() + numBins, FFT::Complex {});
+}
+
+//==============================================================================
+void PhaseVocoder::runEnvelopeUnit (Channel& channel, Stage stage) noexcept
+{
+    //real cepstrum of the decimated log spectrum, liftered and transformed back into a smooth log envelope
+    auto* spectrum = channel.envelopeSpectrum.data();
+    auto* work = channel.envelopeWork.data();
+    auto* cepstrum = channel.cepstrum.data();
+    const auto envelopeSize = envelopeFft->getSize();
+    const auto envelopeBins = envelopeSize / 2 + 1;
+
+    switch (stage)
+    {
+        case Stage::envelopeLog:
+        {
+            //each decimated bin takes the loudest bin around it, so the envelope rides over the harmonics
+            const auto* magnitude = channel.magnitude.data();
+            const auto lastBin = numBins - 1;
+            auto frameLoudest = silentMagnitude;
+
+            for (int j = 0; j < envelopeBins; ++j)
+            {
+                const auto first = std::max (0, j * envelopeDecimation - envelopeDecimation / 2);
+                const auto last = std::min (lastBin, j * envelopeDecimation + envelopeDecimation / 2 - 1);
+                auto loudest = 0.0f;
+
+                for (int k = first; k <= last; ++k)
+                    loudest = std::max (loudest, magnitude[k]);
+
+                spectrum[j] = { loudest, 0.0f };
+                frameLoudest = std::max (frameLoudest, loudest);
+            }
+
+            const auto floor = frameLoudest * envelopeFloor;
+
+            for (int j = 0; j < envelopeBins; ++j)
+                spectrum[j] = { std::log (std::max (spectrum[j].real(), floor)), 0.0f };
+
+            envelopeFft->packInverse (spectrum, work);
+            break;
+        }
+
+        case Stage::envelopeInverse:
+            for (int pass = 0; pass < envelopeFft->getNumPasses(); ++pass)
+                envelopeFft->performPass (work, pass, true);
+
+            break;
+
+        case Stage::envelopeLifter:
+        {
+            //keep the low quefrencies, symmetrically, with the cutoff coefficient halved
+            envelopeFft->unpackInverse (work, cepstrum);
+
+            cepstrum[liftering] *= 0.5f;
+            cepstrum[envelopeSize - liftering] *= 0.5f;
+            std::fill (cepstrum + liftering + 1, cepstrum + envelopeSize - liftering, 0.0f);
+
+            envelopeFft->packForward (cepstrum, work);
+            break;
+        }
+
+        case Stage::envelopeForward:
+            for (int pass = 0; pass < envelopeFft->getNumPasses(); ++pass)
+                envelopeFft->performPass (work, pass, false);
+
+            break;
+
+        case Stage::envelopeStore:
+        {
+            //back to a magnitude for every bin, linear in log magnitude between the decimated bins
+            envelopeFft->unpackForward (work, spectrum);
+
+            auto* envelope = channel.envelope.data();
+            const auto lastIndex = envelopeBins - 2;
+
+            for (int k = 0; k < numBins; ++k)
+            {
+                const auto position = (float) k / (float) envelopeDecimation;
+                const auto index = std::min ((int) position, lastIndex);
+                const auto fraction = position - (float) index;
+                const auto low = spectrum[index].real();
+
+                envelope[k] = std::exp (low + fraction * (spectrum[index + 1].real() - low));
+            }
+
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+float PhaseVocoder::envelopeAt (const Channel& channel, float bin) const noexcept
+{
+    //held past the last bin
+    const auto lastBin = numBins - 1;
+    const auto position = std::min (bin, (float) lastBin);
+    const auto index = std::min ((int) position, lastBin - 1);
+    const auto fraction = position - (float) index;
+    const auto* envelope = channel.envelope.data();
+
+    return envelope[index] + fraction * (envelope[index + 1] - envelope[index]);
+}
+
+void PhaseVocoder::shiftPeaks (Channel& channel, int slice) noexcept
+{
+    const auto* magnitude = channel.magnitude.data();
+    const auto* phase = channel.phase.data();
+    const auto* frequency = channel.frequency.data();
+    auto* spectrum = channel.spectrum.data();
+    const auto lastBin = numBins - 1;
+    const auto advancePerBin = twoPi * (float) hopSize / (float) frameSize;
+
+    for (int p = sliceFirstPeak[(size_t) slice]; p < sliceFirstPeak[(size_t) slice + 1]; ++p)
+    {
+        const auto peak = peaks[(size_t) p];
+        const auto regionStart = p == 0 ? 0 : (peaks[(size_t) p - 1] + peak) / 2 + 1;
+        const auto regionEnd = p == numPeaks - 1 ? lastBin : (peak + peaks[(size_t) p + 1]) / 2;
+
+        //the region moves by the peak's change in frequency, so a ratio of 1 leaves it in place
+        const auto shiftedFrequency = frequency[peak] * framePitchRatio;
+        const auto offset = (int) std::lround (shiftedFrequency - frequency[peak]);
+        const auto target = peak + offset;
+
+        //continue the phase of the peak this one grew out of, advanced at the shifted frequency
+        const auto previousPeak = channel.regionPeak[(size_t) peak];
+        const auto outputPhase = wrapPhase (channel.peakPhase[(size_t) previousPeak] + advancePerBin * shiftedFrequency);
+        channel.nextPeakPhase[(size_t) peak] = outputPhase;
+
+        //peaks shifted past Nyquist are dropped rather than aliased
+        if (target < 0 || target > lastBin)
+            continue;
+
+        //the region moves as one, keeping each bin's phase relative to the peak
+        const auto first = std::max (regionStart, -offset);
+        const auto last = std::min (regionEnd, lastBin - offset);
+
+        if (framePreservesFormants)
+        {
+            //swap the envelope each bin brought with it for the one at its new place
+            const auto* envelope = channel.envelope.data();
+            const auto envelopeScale = 1.0f / frameFormantRatio;
+
+            for (int k = first; k <= last; ++k)
+            {
+                const auto gain = std::min (envelopeAt (channel, (float) (k + offset) * envelopeScale) / envelope[k], maxFormantBoost);
+
+                spectrum[k + offset] += std::polar (magnitude[k] * gain, outputPhase + (phase[k] - phase[peak]));
+            }
+        }
+        else
+        {
+            for (int k = first; k <= last; ++k)
+                spectrum[k + offset] += std::polar (magnitude[k], outputPhase + (phase[k] - phase[peak]));
+        }
+    }
+
+    if (slice == numSlices - 1)
+    {
+        //a real signal has no imaginary part at DC or Nyquist
+        spectrum[0] = { spectrum[0].real(), 0.0f };
+        spectrum[lastBin] = { spectrum[lastBin].real(), 0.0f };
+
+        channel.regionPeak.swap (channel.nextRegionPeak);
+        channel.peakPhase.swap (channel.nextPeakPhase);
+    }
+}
+
+} // namespace jafftune
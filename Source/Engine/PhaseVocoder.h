@@ -0,0 +1,215 @@
+/*
+  ==============================================================================
+
+    PhaseVocoder.h
+    Phase-locked FFT pitch shifter with an evenly spread frame workload.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "FFT.h"
+
+#include <vector>
+
+namespace jafftune
+{
+
+//==============================================================================
+/** Frame size of the phase vocoder, in the plugin's "Vocoder Quality" order. */
+enum class VocoderQuality
+{
+    lowLatency = 0,     // ~20 ms frames
+    balanced,           // ~40 ms frames
+    highQuality,        // ~80 ms frames; best for low notes and dense chords
+    numQualities
+};
+
+//==============================================================================
+/**
+    Pitch shifter that moves spectral peaks rather than resampling a delay line.
+
+    Each frame is Hann windowed and transformed, every bin's true frequency is
+    estimated from its phase advance, and each spectral peak is moved to its
+    shifted frequency together with the bins around it. The bins keep their
+    phase relative to the peak (Laroche and Dolson's identity phase locking)
+    and the peak's phase is carried on from the peak it continues in the
+    previous frame, which keeps transients and chords far less smeared and
+    phasey than per-bin processing. Frames overlap four times.
+
+    With formant preservation on, a cepstral spectral envelope is taken from
+    the input and the shifted spectrum is re-weighted so it follows that
+    envelope again (optionally scaled by its own formant ratio), which keeps
+    voices from turning into chipmunks. The envelope comes from a quarter-
+    resolution log spectrum and is only recomputed every other frame, so it
+    adds a fraction of the vocoder's own cost.
+
+    A frame's work is not done all at once when the frame fills up: it is cut
+    into stages (windowing, each FFT pass, analysis and peak shifting a slice
+    of bins at a time, each inverse pass, overlap-add) that are run in
+    proportion to the samples processed over the following hop. That costs
+    one extra hop of latency but keeps the CPU used per block flat, whatever
+    the block size.
+*/
+class PhaseVocoder
+{
+public:
+    //==============================================================================
+    static constexpr int overlap = 4;
+
+    PhaseVocoder() = default;
+
+    /** Builds the FFTs and buffers for every quality at this sample rate. Not real-time safe. */
+    void prepare (double sampleRate, int numChannels);
+
+    /** Frees everything prepare() built, keeping the settings. process() does
+        nothing until the vocoder is prepared again. Not real-time safe.
+    */
+    void release();
+
+    bool isPrepared() const noexcept            { return fft != nullptr; }
+
+    /** Clears the history, the overlap-add buffers and any frame in progress. */
+    void reset() noexcept;
+
+    /** Switches frame size. Real-time safe; restarts the frames, so the output briefly drops out. */
+    void setQuality (VocoderQuality newQuality) noexcept;
+
+    /** Ratio of output pitch to input pitch, picked up at the start of each frame. */
+    void setPitchRatio (float newPitchRatio) noexcept     { pitchRatio = newPitchRatio; }
+
+    /** Keeps the input's spectral envelope on the shifted output, moved by
+        formantRatio (1 = formants stay where they were). Picked up at the start of each frame.
+    */
+    void setFormantPreservation (bool shouldPreserve, float newFormantRatio) noexcept;
+
+    /** Delay of both the shifted and the dry output: a frame plus a hop. */
+    int getLatencyInSamples() const noexcept    { return frameSize + hopSize; }
+
+    /** How long the shifted output keeps going once the input falls silent:
+        the latency, plus the last frame the input reached.
+    */
+    int getTailLengthInSamples() const noexcept { return 2 * frameSize + hopSize; }
+
+    VocoderQuality getQuality() const noexcept  { return quality; }
+
+    //==============================================================================
+    /** Reads numChannels channels of input from io, replaces them with the input
+        delayed by getLatencyInSamples() (so a dry signal lines up with the
+        shifted one) and writes the shifted signal to wet. Never allocates.
+    */
+    void process (float* const* io, float* const* wet, int numChannels, int numSamples) noexcept;
+
+    /** Keeps a channel that process() isn't running in step with the others:
+        its input joins the history and its stale output is dropped, so it can
+        be picked up later without a step. Call before process() for the same
+        block.
+    */
+    void writeInput (int channel, const float* input, int numSamples) noexcept;
+
+private:
+    //==============================================================================
+    enum class Stage
+    {
+        windowAndPack,
+        forwardPass,
+        unpack,
+        analyse,
+        envelopeLog,
+        envelopeInverse,
+        envelopeLifter,
+        envelopeForward,
+        envelopeStore,
+        findPeaks,
+        shiftPeaks,
+        packInverse,
+        inversePass,
+        overlapAdd
+    };
+
+    struct WorkUnit
+    {
+        Stage stage;
+        int index;          // the pass, or the slice of bins
+        float costBefore;   // summed cost of the channel's earlier units
+    };
+
+    struct Channel
+    {
+        std::vector<float> input;           // ring of recent input, also read back as the delayed dry signal
+        std::vector<float> output;          // overlap-add ring, cleared as it is read
+        std::vector<float> frame;
+        std::vector<FFT::Complex> work;
+        std::vector<FFT::Complex> spectrum;
+        std::vector<float> magnitude;
+        std::vector<float> phase;
+        std::vector<float> frequency;       // true frequency of each bin, in bins
+        std::vector<float> lastPhase;
+        std::vector<int> regionPeak;        // the peak whose region each bin was in, last frame and this one
+        std::vector<int> nextRegionPeak;
+        std::vector<float> peakPhase;       // output phase given to each peak, by analysis bin
+        std::vector<float> nextPeakPhase;
+
+        std::vector<FFT::Complex> envelopeSpectrum;
+        std::vector<FFT::Complex> envelopeWork;
+        std::vector<float> cepstrum;
+        std::vector<float> envelope;        // smoothed magnitude, expanded back to every bin
+    };
+
+    void configure (VocoderQuality newQuality) noexcept;
+    void buildUnits (bool withEnvelope) noexcept;
+    void startFrame (int numChannels) noexcept;
+    void runWork (float target) noexcept;
+    void runUnit (Channel& channel, const WorkUnit& unit) noexcept;
+    void analyse (Channel& channel, int slice) noexcept;
+    void findPeaks (Channel& channel) noexcept;
+    void shiftPeaks (Channel& channel, int slice) noexcept;
+    void runEnvelopeUnit (Channel& channel, Stage stage) noexcept;
+    float envelopeAt (const Channel& channel, float bin) const noexcept;
+
+    //==============================================================================
+    double sampleRate = 44100.0;
+
+    FFT ffts[(int) VocoderQuality::numQualities];
+    FFT envelopeFfts[(int) VocoderQuality::numQualities];
+    std::vector<float> windows[(int) VocoderQuality::numQualities];
+    std::vector<Channel> channels;
+    std::vector<int> peaks;
+    std::vector<int> sliceFirstPeak;    // index of the first peak in each slice of bins, plus an end marker
+    int numPeaks = 0;
+    int numSlices = 0;
+
+    VocoderQuality quality = VocoderQuality::balanced;
+    const FFT* fft = nullptr;
+    const FFT* envelopeFft = nullptr;
+    const float* window = nullptr;
+    int frameSize = 0;
+    int hopSize = 0;
+    int numBins = 0;
+
+    //input and output rings share one power-of-two size and write position
+    int ringMask = 0;
+    int writePosition = 0;
+
+    //the frame in progress: its units are run in step with the hop
+    std::vector<WorkUnit> units;
+    float channelCost = 0.0f;
+    int frameEnd = 0;
+    int frameChannels = 0;
+    int nextUnit = 0;
+    int hopPosition = 0;
+    int frameCount = 0;
+
+    float pitchRatio = 1.0f;
+    float framePitchRatio = 1.0f;
+
+    //formant preservation, latched for each frame
+    bool preserveFormants = false;
+    float formantRatio = 1.0f;
+    bool framePreservesFormants = false;
+    float frameFormantRatio = 1.0f;
+    int liftering = 1;                  // cepstral coefficients kept either side of zero
+};
+
+} // namespace jafftune
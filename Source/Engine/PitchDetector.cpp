@@ -0,0 +1,236 @@
+/*
+  ==============================================================================
+
+    PitchDetector.cpp
+    Incremental YIN fundamental-frequency estimator and scale snapping.
+
+  ==============================================================================
+*/
+
+#include "PitchDetector.h"
+#include "VectorOps.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace jafftune
+{
+
+namespace
+{
+    //the detector runs near this rate whatever the host rate is
+    constexpr double targetDecimatedRate = 11025.0;
+
+    //decimated samples between estimates (about 1.5 ms)
+    constexpr int decimatedHopLength = 16;
+
+    //mean squared difference per lag below which the input counts as silent (about -70 dBFS)
+    constexpr float silenceLevel = 1.0e-7f;
+
+    //pitch classes in each scale, from the root
+    constexpr bool scaleDegrees[(int) Scale::numScales][12] =
+    {
+        { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 },     // chromatic
+        { 1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1 },     // major
+        { 1, 0, 1, 1, 0, 1, 0, 1, 1, 0, 1, 0 },     // natural minor
+        { 1, 0, 1, 1, 0, 1, 0, 1, 1, 0, 0, 1 },     // harmonic minor
+        { 1, 0, 1, 0, 1, 0, 0, 1, 0, 1, 0, 0 },     // major pentatonic
+        { 1, 0, 0, 1, 0, 1, 0, 1, 0, 0, 1, 0 }      // minor pentatonic
+    };
+}
+
+//==============================================================================
+float snapToScale (float midiNote, int key, Scale scale) noexcept
+{
+    const auto& degrees = scaleDegrees[std::clamp ((int) scale, 0, (int) Scale::numScales - 1)];
+    const auto nearest = (int) std::lround (midiNote);
+
+    //every scale has a note within 3 semitones, so search outwards from the nearest semitone
+    auto best = (float) nearest;
+    auto bestDistance = 12.0f;
+
+    for (int offset = -3; offset <= 3; ++offset)
+    {
+        const auto candidate = nearest + offset;
+        const auto pitchClass = ((candidate - key) % 12 + 12) % 12;
+        const auto distance = std::abs ((float) candidate - midiNote);
+
+        if (degrees[pitchClass] && distance < bestDistance)
+        {
+            best = (float) candidate;
+            bestDistance = distance;
+        }
+    }
+
+    return best;
+}
+
+//==============================================================================
+void PitchDetector::prepare (double sampleRate)
+{
+    decimation = std::max (1, (int) std::lround (sampleRate / targetDecimatedRate));
+    decimatedRate = sampleRate / decimation;
+
+    minimumLag = std::max (2, (int) (decimatedRate / maximumFrequency));
+    maximumLag = (int) std::ceil (decimatedRate / minimumFrequency);
+    windowLength = maximumLag;
+    hopLength = decimatedHopLength;
+
+    //room for a full window compared against the longest lag, plus a vector's overrun
+    capacity = 1;
+    while (capacity < windowLength + maximumLag + simd::Vec::size + 1)
+        capacity <<= 1;
+
+    history.assign ((size_t) capacity * 2, 0.0f);
+
+    difference.assign ((size_t) (maximumLag + simd::Vec::size + 1), 0.0f);
+    normalised.assign ((size_t) (maximumLag + simd::Vec::size + 1), 1.0f);
+
+    reset();
+}
+
+void PitchDetector::reset() noexcept
+{
+    std::fill (history.begin(), history.end(), 0.0f);
+    std::fill (difference.begin(), difference.end(), 0.0f);
+    std::fill (normalised.begin(), normalised.end(), 1.0f);
+
+    newest = 0;
+    decimationSum = 0.0f;
+    decimationCount = 0;
+    samplesSinceEstimate = 0;
+    samplesSeen = 0;
+    refreshLag = 1;
+    frequency = 0.0f;
+    confidence = 0.0f;
+}
+
+//==============================================================================
+void PitchDetector::process (const float* left, const float* right, int numSamples) noexcept
+{
+    if (history.empty())
+        return;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        decimationSum += right != nullptr ? (left[i] + right[i]) * 0.5f : left[i];
+
+        //a boxcar average is enough anti-aliasing for the fundamental range
+        if (++decimationCount == decimation)
+        {
+            pushDecimated (decimationSum / (float) decimation);
+            decimationSum = 0.0f;
+            decimationCount = 0;
+        }
+    }
+}
+
+void PitchDetector::pushDecimated (float sample) noexcept
+{
+    using simd::Vec;
+
+    newest = (newest + capacity - 1) & (capacity - 1);
+    history[(size_t) newest] = sample;
+    history[(size_t) (newest + capacity)] = sample;
+
+    const auto* x = historyFromNewest();
+    auto* d = difference.data();
+
+    //slide the window one sample: add the newest pair, drop the oldest. Lags
+    //are padded up to a whole vector, and the padding lanes are never read
+    const auto newestSample = Vec::broadcast (sample);
+    const auto leavingSample = Vec::broadcast (x[windowLength]);
+
+    for (int lag = 1; lag <= maximumLag; lag += Vec::size)
+    {
+        const auto added = newestSample - Vec::load (x + lag);
+        const auto removed = leavingSample - Vec::load (x + windowLength + lag);
+        (Vec::load (d + lag) + added * added - removed * removed).store (d + lag);
+    }
+
+    //recompute one lag exactly, so every lag is refreshed once per maximumLag samples
+    alignas (32) float lanes[Vec::size];
+    auto sum = Vec::broadcast (0.0f);
+    int age = 0;
+
+    for (; age + Vec::size <= windowLength; age += Vec::size)
+    {
+        const auto delta = Vec::load (x + age) - Vec::load (x + age + refreshLag);
+        sum = sum + delta * delta;
+    }
+
+    sum.store (lanes);
+    auto total = 0.0f;
+
+    for (auto lane : lanes)
+        total += lane;
+
+    for (; age < windowLength; ++age)
+    {
+        const auto delta = x[age] - x[age + refreshLag];
+        total += delta * delta;
+    }
+
+    d[refreshLag] = total;
+    refreshLag = refreshLag < maximumLag ? refreshLag + 1 : 1;
+
+    samplesSeen = std::min (samplesSeen + 1, windowLength + maximumLag);
+
+    if (++samplesSinceEstimate >= hopLength)
+    {
+        samplesSinceEstimate = 0;
+        estimate();
+    }
+}
+
+void PitchDetector::estimate() noexcept
+{
+    //nothing to compare until the window and the longest lag are filled
+    if (samplesSeen < windowLength + maximumLag)
+        return;
+
+    const auto* d = difference.data();
+    auto* cmnd = normalised.data();
+    auto runningSum = 0.0f;
+
+    for (int lag = 1; lag <= maximumLag; ++lag)
+    {
+        runningSum += std::max (0.0f, d[lag]);
+        cmnd[lag] = runningSum > 0.0f ? d[lag] * (float) lag / runningSum : 1.0f;
+    }
+
+    if (runningSum < silenceLevel * (float) (maximumLag * windowLength))
+    {
+        frequency = 0.0f;
+        confidence = 0.0f;
+        return;
+    }
+
+    //first dip under the threshold, followed down to its local minimum
+    auto lag = minimumLag;
+
+    while (lag < maximumLag && cmnd[lag] >= threshold)
+        ++lag;
+
+    if (lag >= maximumLag)
+    {
+        frequency = 0.0f;
+        confidence = 0.0f;
+        return;
+    }
+
+    while (lag + 1 < maximumLag && cmnd[lag + 1] < cmnd[lag])
+        ++lag;
+
+    //parabolic interpolation around the minimum
+    const auto before = cmnd[lag - 1];
+    const auto at = cmnd[lag];
+    const auto after = cmnd[lag + 1];
+    const auto curvature = before - 2.0f * at + after;
+    const auto offset = curvature > 0.0f ? std::clamp (0.5f * (before - after) / curvature, -0.5f, 0.5f) : 0.0f;
+
+    frequency = (float) (decimatedRate / ((double) lag + (double) offset));
+    confidence = std::clamp (1.0f - at, 0.0f, 1.0f);
+}
+
+} // namespace jafftune
@@ -0,0 +1,116 @@
+/*
+  ==============================================================================
+
+    PitchDetector.h
+    Incremental YIN fundamental-frequency estimator and scale snapping.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace jafftune
+{
+
+//==============================================================================
+/** Scales the pitch correction mode can snap to, in the plugin's "Correction Scale" order. */
+enum class Scale
+{
+    chromatic = 0,
+    major,
+    naturalMinor,
+    harmonicMinor,
+    majorPentatonic,
+    minorPentatonic,
+    numScales
+};
+
+/** Nearest note of a scale to a (fractional) MIDI note number. key is the
+    scale's root as a pitch class, 0 = C through 11 = B.
+*/
+float snapToScale (float midiNote, int key, Scale scale) noexcept;
+
+//==============================================================================
+/**
+    Real-time YIN pitch detector that works on a sliding window.
+
+    The input is decimated to roughly 11 kHz and the YIN difference function
+    d(tau) is kept up to date one decimated sample at a time: each new sample
+    adds its own squared difference and removes the one leaving the window,
+    so a 64-sample host block costs a few hundred multiply-adds per lag
+    rather than a fresh autocorrelation. One lag per sample is also summed
+    from scratch, which bounds the rounding drift of the running sums.
+    The cumulative mean normalised difference is evaluated once per hop.
+*/
+class PitchDetector
+{
+public:
+    //==============================================================================
+    /** Lowest and highest fundamentals the detector looks for, in Hz. */
+    static constexpr float minimumFrequency = 60.0f;
+    static constexpr float maximumFrequency = 1000.0f;
+
+    PitchDetector() = default;
+
+    /** Sizes the history and difference function for a sample rate. Not real-time safe. */
+    void prepare (double sampleRate);
+
+    /** Forgets the history and the last estimate. */
+    void reset() noexcept;
+
+    /** YIN's absolute threshold on the normalised difference; lower is stricter. */
+    void setThreshold (float newThreshold) noexcept     { threshold = newThreshold; }
+
+    //==============================================================================
+    /** Feeds a block of input (right may be null for mono) and updates the
+        estimate every hop. Never allocates.
+    */
+    void process (const float* left, const float* right, int numSamples) noexcept;
+
+    /** Latest fundamental in Hz, or 0 if the input is unvoiced or silent. */
+    float getFrequency() const noexcept     { return frequency; }
+
+    /** 1 minus the normalised difference at the chosen lag; 0 when unvoiced. */
+    float getConfidence() const noexcept    { return confidence; }
+
+private:
+    //==============================================================================
+    void pushDecimated (float sample) noexcept;
+    void estimate() noexcept;
+
+    /** history + age is the sample age decimated samples old, for any age below the capacity. */
+    const float* historyFromNewest() const noexcept     { return history.data() + newest; }
+
+    //==============================================================================
+    double decimatedRate = 11025.0;
+    int decimation = 1;
+    int minimumLag = 1;
+    int maximumLag = 1;
+    int windowLength = 1;
+    int hopLength = 1;
+
+    //decimated input, newest first, in a power-of-two ring written twice over
+    //so any window of it can be read as one contiguous run
+    std::vector<float> history;
+    int capacity = 0;
+    int newest = 0;
+
+    //d(tau) and its cumulative mean normalised form, indexed by lag
+    std::vector<float> difference;
+    std::vector<float> normalised;
+
+    float decimationSum = 0.0f;
+    int decimationCount = 0;
+    int samplesSinceEstimate = 0;
+    int samplesSeen = 0;
+    int refreshLag = 1;
+
+    float threshold = 0.15f;
+    float frequency = 0.0f;
+    float confidence = 0.0f;
+};
+
+} // namespace jafftune
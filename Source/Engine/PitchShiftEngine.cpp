@@ -0,0 +1,1078 @@
+/*
+  ==============================================================================
+
+    PitchShiftEngine.cpp
+    Host-independent variable-rate delay pitch shifter used by Jafftune.
+
+  ==============================================================================
+*/
+
+#include "PitchShiftEngine.h"
+#include "VectorOps.h"
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+namespace jafftune
+{
+
+namespace
+{
+    constexpr float pi = 3.14159265358979323846f;
+
+    //time constant of the onePole that smooths the tap delays
+    constexpr float delaySmoothingTimeMs = 0.05f;
+
+    //the pitch correction ratio is updated this often, so it tracks within a 64-sample host block
+    constexpr int correctionHopSize = 64;
+
+    //ramp time for the mix, output gain and pitch ratio
+    constexpr float parameterSmoothingTimeMs = 50.0f;
+
+    //length of the cross-fade between grain sets when the window changes
+    constexpr float windowCrossfadeTimeMs = 50.0f;
+
+    //length of each half of a mode switch: the old mode fading to dry, then the new one fading in
+    constexpr float modeFadeTimeMs = 5.0f;
+}
+
+//==============================================================================
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::prepare (double newSampleRate, int maximumBlockSize, int numChannels)
+{
+    (void) maximumBlockSize;
+
+    sampleRate = newSampleRate;
+
+    //enough history for the longest window plus one grain block and the
+    //Hermite neighbours, rather than a whole second per channel
+    const auto maximumDelayInSamples = (int) std::ceil (msToSamps (maximumDelayWindow));
+
+    //a stereo engine keeps the harmonizer's mono sum in a channel after the
+    //inputs, while a mono engine's only input already is its sum
+    sumChannel = numChannels > 1 ? numChannels : 0;
+    delayBuffer.prepare (std::max (sumChannel + 1, numChannels), maximumDelayInSamples + grainBlockSize + interpolationMargin);
+
+    smoothingCoefficient = delaySmoothingCoefficient (sampleRate);
+
+    detector.prepare (sampleRate);
+
+    if (vocoderEnabled)
+        vocoder.prepare (sampleRate, numChannels);
+    else
+        vocoder.release();
+
+    pitchRatio.reset (sampleRate, parameterSmoothingTimeMs);
+    dryGain.reset (sampleRate, parameterSmoothingTimeMs);
+    wetGain.reset (sampleRate, parameterSmoothingTimeMs);
+    outputGain.reset (sampleRate, parameterSmoothingTimeMs);
+
+    crossfadeLength = std::max (1, (int) msToSamps (windowCrossfadeTimeMs));
+    modeFadeLength = std::max (1, (int) msToSamps (modeFadeTimeMs));
+
+    reset();
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::reset()
+{
+    delayBuffer.reset();
+    grains = {};
+    grains.windowMs = delayWindow;
+    crossfadeRemaining = 0;
+    silentSamples = 0;
+    sleeping = false;
+    currentMode = OperationMode::numModes;
+    currentUsesVocoder = false;
+    modeFadePosition = modeFadeLength;
+    vocoderRampPosition = modeFadeLength;
+    freshHistory = 0;
+
+    std::fill (std::begin (voices.phase), std::end (voices.phase), 0.0f);
+    std::fill (std::begin (voices.lastDelayOne), std::end (voices.lastDelayOne), 0.0f);
+    std::fill (std::begin (voices.lastDelayTwo), std::end (voices.lastDelayTwo), 0.0f);
+
+    detector.reset();
+    vocoder.reset();
+    correctionSemitones = 0.0f;
+    correctionRatio = 1.0;
+
+    //parameters set before a reset apply straight away rather than gliding in
+    pitchRatio.setCurrentAndTarget (pitchRatio.getTarget());
+    dryGain.setCurrentAndTarget (dryGain.getTarget());
+    wetGain.setCurrentAndTarget (wetGain.getTarget());
+    outputGain.setCurrentAndTarget (outputGain.getTarget());
+
+    updatePhaseIncrement();
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::resetToBypass (OperationMode bypassMode)
+{
+    reset();
+    currentMode = bypassMode == OperationMode::monoBypass ? OperationMode::monoBypass : OperationMode::stereoBypass;
+}
+
+template <typename SampleType>
+bool PitchShiftEngine<SampleType>::isBypassed() const noexcept
+{
+    return (currentMode == OperationMode::monoBypass || currentMode == OperationMode::stereoBypass)
+        && modeFadePosition == modeFadeLength;
+}
+
+//==============================================================================
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::setPitchRatio (float newPitchRatio, bool immediate)
+{
+    if (immediate)
+        pitchRatio.setCurrentAndTarget (newPitchRatio);
+    else
+        pitchRatio.setTarget (newPitchRatio);
+
+    updatePhaseIncrement();
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::setMaximumDelayWindow (float newMaximumDelayWindowMs)
+{
+    maximumDelayWindow = std::max (1.0f, newMaximumDelayWindowMs);
+    delayWindow = std::min (delayWindow, maximumDelayWindow);
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::setDelayWindow (float newDelayWindowMs)
+{
+    delayWindow = std::clamp (newDelayWindowMs, 0.1f, maximumDelayWindow);
+
+    //until there's audio in flight the grains can switch windows outright;
+    //afterwards computeGrains() starts a cross-fade
+    if (delayBuffer.getCapacity() == 0)
+        grains.windowMs = delayWindow;
+
+    updatePhaseIncrement();
+}
+
+template <typename SampleType>
+float PitchShiftEngine<SampleType>::windowForRatio (float ratio, float longestWindowMs) noexcept
+{
+    //phasorFreq = 1000 * |1 - ratio| / window, solved for the window
+    const auto window = std::round (1000.0f * std::abs (1.0f - ratio) / adaptivePhasorFrequency);
+    return std::clamp (window, minimumAdaptiveWindow, std::max (minimumAdaptiveWindow, longestWindowMs));
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::setMix (float newDryGain, float newWetGain)
+{
+    dryGain.setTarget (newDryGain);
+    wetGain.setTarget (newWetGain);
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::setOutputGain (float newOutputGain)
+{
+    outputGain.setTarget (newOutputGain);
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::setInterpolation (Interpolation newInterpolation)
+{
+    interpolation = newInterpolation;
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::setAlgorithm (Algorithm newAlgorithm)
+{
+    algorithm = newAlgorithm;
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::setPhaseVocoderEnabled (bool shouldEnable)
+{
+    vocoderEnabled = shouldEnable;
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::setVocoderQuality (VocoderQuality newQuality)
+{
+    vocoder.setQuality (newQuality);
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::setFormantPreservation (bool shouldPreserve, float formantRatio)
+{
+    preserveFormants = shouldPreserve;
+    vocoder.setFormantPreservation (shouldPreserve, formantRatio);
+}
+
+template <typename SampleType>
+bool PitchShiftEngine<SampleType>::runsPhaseVocoder (OperationMode mode) const noexcept
+{
+    return (algorithm == Algorithm::phaseVocoder || preserveFormants) && vocoder.isPrepared()
+        && (mode == OperationMode::mono || mode == OperationMode::stereoWetWet || mode == OperationMode::stereoDryWet);
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::setLatencyCompensation (bool shouldCompensate)
+{
+    compensateLatency = shouldCompensate;
+}
+
+template <typename SampleType>
+int PitchShiftEngine<SampleType>::getLatencyInSamples (OperationMode mode) const noexcept
+{
+    if (runsPhaseVocoder (mode))
+        return vocoder.getLatencyInSamples();
+
+    if (compensatesLatency (mode, false))
+        return getLatencyInSamples();
+
+    return 0;
+}
+
+template <typename SampleType>
+int PitchShiftEngine<SampleType>::getTailLengthInSamples (OperationMode mode) const noexcept
+{
+    if (mode == OperationMode::monoBypass || mode == OperationMode::stereoBypass)
+        return 0;
+
+    if (runsPhaseVocoder (mode))
+        return vocoder.getTailLengthInSamples();
+
+    //the taps reach back a window at most, or the old window while one is fading out
+    const auto longestWindow = crossfadeRemaining > 0 ? std::max (delayWindow, fadingGrains.windowMs) : delayWindow;
+    return (int) std::ceil (msToSamps (longestWindow)) + interpolationMargin;
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::setNumHarmonyVoices (int newNumVoices)
+{
+    voices.numActive = std::clamp (newNumVoices, 0, maxHarmonyVoices);
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::setHarmonyVoice (int voiceIndex, float ratio, float gain, float pan)
+{
+    if (voiceIndex < 0 || voiceIndex >= maxHarmonyVoices)
+        return;
+
+    //constant-power pan
+    const auto angle = (std::clamp (pan, -1.0f, 1.0f) + 1.0f) * 0.25f * pi;
+
+    voices.ratio[voiceIndex] = ratio;
+    voices.gainLeft[voiceIndex] = gain * std::cos (angle);
+    voices.gainRight[voiceIndex] = gain * std::sin (angle);
+    updatePhaseIncrement();
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::setPitchCorrection (Scale newScale, int newKey, float newRetuneSpeedMs)
+{
+    correctionScale = newScale;
+    correctionKey = ((newKey % 12) + 12) % 12;
+    retuneSpeed = std::max (0.0f, newRetuneSpeedMs);
+}
+
+template <typename SampleType>
+double PitchShiftEngine<SampleType>::incrementForRatio (double ratio, float windowMs) const noexcept
+{
+    return phasorIncrement (ratio, windowMs, sampleRate);
+}
+
+template <typename SampleType>
+double PitchShiftEngine<SampleType>::phasorIncrement (double ratio, float windowMs, double rate) noexcept
+{
+    //phasor~ frequency in Hz, as a fraction of a cycle per sample
+    const auto phasorFreq = 1000.0 * ((1.0 - ratio) / (double) windowMs);
+    return phasorFreq / rate;
+}
+
+template <typename SampleType>
+float PitchShiftEngine<SampleType>::delaySmoothingCoefficient (double rate) noexcept
+{
+    //onePole from https://www.musicdsp.org/en/latest/Filters/257-1-pole-lpf-for-smooth-parameter-changes.html
+    return std::exp (-2.0f * pi / (delaySmoothingTimeMs * 0.001f * (float) rate));
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::updatePhaseIncrement() noexcept
+{
+    const auto ratio = (double) pitchRatio.getCurrent() * correctionRatio;
+    grains.increment = incrementForRatio (ratio, grains.windowMs);
+    fadingGrains.increment = incrementForRatio (ratio, fadingGrains.windowMs);
+
+    for (int v = 0; v < maxHarmonyVoices; ++v)
+    {
+        voices.increment[v] = (float) incrementForRatio ((double) voices.ratio[v], delayWindow);
+        voices.moving[v] = voices.ratio[v] != 1.0f ? 1.0f : 0.0f;
+    }
+}
+
+//==============================================================================
+template <typename SampleType>
+bool PitchShiftEngine<SampleType>::computeGrains (int numSamples) noexcept
+{
+    //a new window starts a cross-fade: the current grains carry on sweeping
+    //the old one while fading out, and a fresh set fades in on the new one
+    if (crossfadeRemaining == 0 && grains.windowMs != delayWindow)
+    {
+        fadingGrains = grains;
+
+        //same phase, so the new taps start at the same fraction of their window
+        const auto rescale = delayWindow / grains.windowMs;
+        grains.windowMs = delayWindow;
+        grains.lastDelayOne *= rescale;
+        grains.lastDelayTwo *= rescale;
+
+        crossfadeRemaining = crossfadeLength;
+        updatePhaseIncrement();
+    }
+
+    //while the ratio glides the increment changes every sample, so both sets share one ramp of it
+    const auto ratioGliding = pitchRatio.isSmoothing();
+
+    if (ratioGliding)
+        for (int i = 0; i < numSamples; ++i)
+            scratch.ratio[i] = pitchRatio.getNext() * (float) correctionRatio;
+
+    renderGrainSet (grains, ratioGliding, numSamples, scratch.delayOne, scratch.delayTwo, scratch.gainOne, scratch.gainTwo);
+
+    const auto fading = crossfadeRemaining > 0;
+
+    if (fading)
+    {
+        renderGrainSet (fadingGrains, ratioGliding, numSamples,
+                        scratch.fadeDelayOne, scratch.fadeDelayTwo, scratch.fadeGainOne, scratch.fadeGainTwo);
+
+        //smoothstep from the old set to the new one, folded into the tap windows
+        const auto done = crossfadeLength - crossfadeRemaining;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto x = std::min (1.0f, (float) (done + i + 1) / (float) crossfadeLength);
+            const auto fadeIn = x * x * (3.0f - 2.0f * x);
+
+            scratch.crossfade[i] = fadeIn;
+            scratch.gainOne[i] *= fadeIn;
+            scratch.gainTwo[i] *= fadeIn;
+            scratch.fadeGainOne[i] *= 1.0f - fadeIn;
+            scratch.fadeGainTwo[i] *= 1.0f - fadeIn;
+        }
+
+        crossfadeRemaining = std::max (0, crossfadeRemaining - numSamples);
+    }
+
+    if (ratioGliding)
+        updatePhaseIncrement();
+
+    return fading;
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::renderGrainSet (GrainSet& set, bool ratioGliding, int numSamples,
+                                                   float* delayOne, float* delayTwo, float* gainOne, float* gainTwo) noexcept
+{
+    if (ratioGliding)
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            set.phase += incrementForRatio ((double) scratch.ratio[i], set.windowMs);
+            set.phase -= std::floor (set.phase);
+            scratch.phasorTap[i] = simd::toUnitPhase (set.phase);
+        }
+    }
+    else if (set.increment != 0.0)
+    {
+        set.phase = simd::fillPhasorRamp (scratch.phasorTap, numSamples, set.phase, set.increment);
+    }
+    else
+    {
+        //a ratio of exactly 1 parks both taps, as the original phasor pair did
+        std::fill (scratch.phasorTap, scratch.phasorTap + numSamples, 0.0f);
+    }
+
+    simd::computeGrainTaps (scratch.phasorTap, delayOne, delayTwo, gainOne, gainTwo, numSamples, msToSamps (set.windowMs));
+
+    //the onePole is recursive, so this part stays scalar
+    auto lastOne = set.lastDelayOne;
+    auto lastTwo = set.lastDelayTwo;
+    const auto a = smoothingCoefficient;
+    const auto b = 1.0f - smoothingCoefficient;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        lastOne = simd::onePole (delayOne[i], lastOne, a, b);
+        lastTwo = simd::onePole (delayTwo[i], lastTwo, a, b);
+        delayOne[i] = lastOne;
+        delayTwo[i] = lastTwo;
+    }
+
+    set.lastDelayOne = lastOne;
+    set.lastDelayTwo = lastTwo;
+}
+
+template <typename SampleType>
+bool PitchShiftEngine<SampleType>::fillGainRamps (int numSamples) noexcept
+{
+    if (! (dryGain.isSmoothing() || wetGain.isSmoothing() || outputGain.isSmoothing()))
+        return false;
+
+    //once any gain moves, all three are written out so the mixing loops stay uniform
+    if (! dryGain.fillRamp (scratch.dryGain, numSamples))
+        std::fill (scratch.dryGain, scratch.dryGain + numSamples, dryGain.getCurrent());
+
+    if (! wetGain.fillRamp (scratch.wetGain, numSamples))
+        std::fill (scratch.wetGain, scratch.wetGain + numSamples, wetGain.getCurrent());
+
+    if (! outputGain.fillRamp (scratch.outputGain, numSamples))
+        std::fill (scratch.outputGain, scratch.outputGain + numSamples, outputGain.getCurrent());
+
+    return true;
+}
+
+//==============================================================================
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::process (SampleType* const* channels, int numChannels, int numSamples, OperationMode mode) noexcept
+{
+    if (numChannels <= 0 || delayBuffer.getCapacity() == 0)
+        return;
+
+    //stereo modes fall back to mono; the harmonizer only keeps mono history so runs on any bus
+    if (numChannels < 2 || delayBuffer.getNumChannels() < 2)
+    {
+        if (mode == OperationMode::stereoBypass)
+            mode = OperationMode::monoBypass;
+        else if (mode == OperationMode::stereoWetWet || mode == OperationMode::stereoDryWet)
+            mode = OperationMode::mono;
+    }
+
+    auto* left = channels[0];
+    auto* right = numChannels > 1 ? channels[1] : nullptr;
+    const auto usesVocoder = runsPhaseVocoder (mode);
+
+    //there's nothing to fade from on the first block
+    if (currentMode == OperationMode::numModes)
+    {
+        enterMode (mode, usesVocoder);
+        modeFadePosition = modeFadeLength;
+    }
+
+    //a new mode (or shifter) fades the old one out to the dry signal and then fades itself in,
+    //so only one of them ever runs and nothing they share is processed twice
+    for (int start = 0; start < numSamples;)
+    {
+        const auto switching = mode != currentMode || usesVocoder != currentUsesVocoder;
+
+        if (switching && modeFadePosition == 0)
+        {
+            enterMode (mode, usesVocoder);
+            continue;
+        }
+
+        auto* blockLeft = left + start;
+        auto* blockRight = right != nullptr ? right + start : nullptr;
+        const auto feedsTaps = readsDelayTaps (currentMode, currentUsesVocoder);
+
+        if (! switching && modeFadePosition == modeFadeLength)
+        {
+            processMode (blockLeft, blockRight, numSamples - start);
+            freshHistory = feedsTaps ? std::min (freshHistory + numSamples - start, delayBuffer.getCapacity()) : 0;
+            return;
+        }
+
+        //bypass and the vocoder leave the delay line alone, so before the taps take over from them the
+        //history is written alongside, and the old mode holds until it will reach back a whole window
+        const auto warming = switching && ! feedsTaps && readsDelayTaps (mode, usesVocoder);
+        const auto holdLength = warming ? getTailLengthInSamples (mode) - modeFadePosition - freshHistory : 0;
+        const auto remaining = holdLength > 0 ? holdLength
+                             : switching ? modeFadePosition
+                                         : modeFadeLength - modeFadePosition;
+        const auto numThisTime = std::min ({ grainBlockSize, numSamples - start, remaining });
+
+        if (warming)
+        {
+            writeHistory (blockLeft, blockRight, numThisTime);
+            delayBuffer.advance (numThisTime);
+        }
+
+        if (holdLength > 0)
+            processMode (blockLeft, blockRight, numThisTime);
+        else
+            fadeMode (blockLeft, blockRight, numThisTime, switching);
+
+        freshHistory = feedsTaps || warming ? std::min (freshHistory + numThisTime, delayBuffer.getCapacity()) : 0;
+        start += numThisTime;
+    }
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::enterMode (OperationMode newMode, bool usesVocoder) noexcept
+{
+    //the vocoder isn't fed while the taps run, so it starts again empty, with its input ramped in
+    if (usesVocoder && ! currentUsesVocoder && currentMode != OperationMode::numModes)
+    {
+        vocoder.reset();
+        vocoderRampPosition = 0;
+    }
+
+    currentMode = newMode;
+    currentUsesVocoder = usesVocoder;
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::fadeMode (SampleType* left, SampleType* right, int numSamples, bool fadingOut) noexcept
+{
+    SampleType* const outputs[] = { left, right };
+
+    for (int ch = 0; ch < 2; ++ch)
+        if (outputs[ch] != nullptr)
+            std::copy (outputs[ch], outputs[ch] + numSamples, scratch.fadeDry[ch]);
+
+    processMode (left, right, numSamples);
+
+    //a mode that delays its dry signal fades against that, read back from the block it just wrote
+    if (compensatesLatency (currentMode, currentUsesVocoder) && ! sleeping)
+        for (int ch = 0; ch < std::min (2, delayBuffer.getNumChannels()); ++ch)
+            if (outputs[ch] != nullptr)
+                delayBuffer.readDelayed (ch, dryDelayFor (grains.windowMs) + numSamples, scratch.fadeDry[ch], numSamples);
+
+    //the dry side of the fade is the input at the output gain, which is what bypass sounds like
+    const auto level = (SampleType) outputGain.getCurrent();
+    const auto step = fadingOut ? -1 : 1;
+
+    for (int ch = 0; ch < 2; ++ch)
+    {
+        if (outputs[ch] == nullptr)
+            continue;
+
+        auto* io = outputs[ch];
+        const auto* dry = scratch.fadeDry[ch];
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto x = (float) (modeFadePosition + step * (i + 1)) / (float) modeFadeLength;
+            const auto fade = (SampleType) (x * x * (3.0f - 2.0f * x));
+            io[i] = dry[i] * level + fade * (io[i] - dry[i] * level);
+        }
+    }
+
+    modeFadePosition += step * numSamples;
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::processMode (SampleType* left, SampleType* right, int numSamples) noexcept
+{
+    const auto mode = currentMode;
+
+    //leaving pitch correction drops its correction, so the plain ratio applies again
+    if (mode != OperationMode::pitchCorrection && correctionRatio != 1.0)
+    {
+        correctionSemitones = 0.0f;
+        correctionRatio = 1.0;
+        updatePhaseIncrement();
+    }
+
+    if (updateSleep (left, right, numSamples, mode))
+    {
+        //only the channels the mode writes are cleared; the mono modes leave the right one alone
+        std::fill (left, left + numSamples, SampleType (0));
+
+        if (right != nullptr && mode != OperationMode::mono
+             && (mode != OperationMode::pitchCorrection || delayBuffer.getNumChannels() > 1))
+            std::fill (right, right + numSamples, SampleType (0));
+
+        return;
+    }
+
+    if (currentUsesVocoder)
+    {
+        switch (mode)
+        {
+            case OperationMode::mono:           processVocoder<OperationMode::mono>         (left, right, numSamples); break;
+            case OperationMode::stereoWetWet:   processVocoder<OperationMode::stereoWetWet> (left, right, numSamples); break;
+            case OperationMode::stereoDryWet:   processVocoder<OperationMode::stereoDryWet> (left, right, numSamples); break;
+            case OperationMode::monoBypass:
+            case OperationMode::stereoBypass:
+            case OperationMode::harmonizer:
+            case OperationMode::pitchCorrection:
+            case OperationMode::numModes:
+            default:                            break;
+        }
+
+        return;
+    }
+
+    //resolve the mode once per block, so the kernels' inner loops never branch on it
+    switch (mode)
+    {
+        case OperationMode::monoBypass:     processBypass<OperationMode::monoBypass>   (left, right, numSamples); break;
+        case OperationMode::stereoBypass:   processBypass<OperationMode::stereoBypass> (left, right, numSamples); break;
+        case OperationMode::mono:           processBlock<OperationMode::mono>         (left, right, numSamples); break;
+        case OperationMode::stereoWetWet:   processBlock<OperationMode::stereoWetWet> (left, right, numSamples); break;
+        case OperationMode::stereoDryWet:   processBlock<OperationMode::stereoDryWet> (left, right, numSamples); break;
+        case OperationMode::harmonizer:     processHarmonizer (left, right, numSamples); break;
+        case OperationMode::pitchCorrection: processPitchCorrection (left, right, numSamples); break;
+        case OperationMode::numModes:
+        default:                            break;
+    }
+}
+
+template <typename SampleType>
+bool PitchShiftEngine<SampleType>::updateSleep (const SampleType* left, const SampleType* right, int numSamples,
+                                                OperationMode mode) noexcept
+{
+    //bypass is cheaper than the check
+    if (mode == OperationMode::monoBypass || mode == OperationMode::stereoBypass)
+    {
+        silentSamples = 0;
+        sleeping = false;
+        return false;
+    }
+
+    auto peak = simd::peakMagnitude (left, numSamples);
+
+    if (right != nullptr && mode != OperationMode::mono)
+        peak = std::max (peak, simd::peakMagnitude (right, numSamples));
+
+    if (peak >= (SampleType) silenceThreshold)
+    {
+        silentSamples = 0;
+        sleeping = false;
+        return false;
+    }
+
+    if (sleeping)
+        return true;
+
+    //this block still carries the end of the tail, so it is processed; the next silent one sleeps
+    silentSamples = std::min (silentSamples + numSamples, 1 << 30);
+    sleeping = silentSamples > getTailLengthInSamples (mode);
+    return false;
+}
+
+template <typename SampleType>
+template <OperationMode mode>
+void PitchShiftEngine<SampleType>::processBypass (SampleType* left, SampleType* right, int numSamples) noexcept
+{
+    constexpr auto numGainedChannels = mode == OperationMode::monoBypass ? 1 : 2;
+    SampleType* const outputs[] = { left, right };
+
+    for (int start = 0; start < numSamples; start += grainBlockSize)
+    {
+        const auto numThisTime = std::min (grainBlockSize, numSamples - start);
+
+        //in place; at a steady unity gain the audio isn't touched at all
+        if (fillGainRamps (numThisTime))
+        {
+            for (int ch = 0; ch < numGainedChannels; ++ch)
+                simd::applyGainRamp (outputs[ch] + start, scratch.outputGain, numThisTime);
+        }
+        else if (const auto level = outputGain.getCurrent(); level != 1.0f)
+        {
+            for (int ch = 0; ch < numGainedChannels; ++ch)
+                simd::applyGain (outputs[ch] + start, numThisTime, level);
+        }
+    }
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::writeHistory (const SampleType* left, const SampleType* right, int numSamples) noexcept
+{
+    delayBuffer.write (0, left, numSamples);
+
+    if (right != nullptr && delayBuffer.getNumChannels() > 1)
+        delayBuffer.write (1, right, numSamples);
+
+    writeSumHistory (left, right, numSamples);
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::writeSumHistory (const SampleType* left, const SampleType* right, int numSamples) noexcept
+{
+    //the mono sum is kept current in every tap mode, so switching to or from
+    //the harmonizer never has a voice sweep across a seam in its history
+    if (sumChannel == 0)
+        return;
+
+    for (int i = 0; i < numSamples; ++i)
+        scratch.monoInput[i] = right != nullptr ? (left[i] + right[i]) * 0.5f : left[i];
+
+    delayBuffer.write (sumChannel, scratch.monoInput, numSamples);
+}
+
+template <typename SampleType>
+template <OperationMode mode>
+void PitchShiftEngine<SampleType>::processBlock (SampleType* left, SampleType* right, int numSamples) noexcept
+{
+    constexpr auto numDelayChannels = mode == OperationMode::mono ? 1 : 2;
+    SampleType* const outputs[] = { left, right };
+
+    for (int start = 0; start < numSamples; start += grainBlockSize)
+    {
+        const auto numThisTime = std::min (grainBlockSize, numSamples - start);
+        const auto ramping = fillGainRamps (numThisTime);
+        const auto fading = computeGrains (numThisTime);
+
+        writeSumHistory (left + start, right != nullptr ? right + start : nullptr, numThisTime);
+
+        for (int ch = 0; ch < numDelayChannels; ++ch)
+        {
+            auto* io = outputs[ch] + start;
+            auto* wet = scratch.wet[ch];
+
+            delayBuffer.write (ch, io, numThisTime);
+
+            if (interpolation == Interpolation::hermite)
+                delayBuffer.template readGrainPair<Interpolation::hermite> (ch, scratch.delayOne, scratch.gainOne,
+                                                                            scratch.delayTwo, scratch.gainTwo, wet, numThisTime);
+            else
+                delayBuffer.template readGrainPair<Interpolation::linear> (ch, scratch.delayOne, scratch.gainOne,
+                                                                           scratch.delayTwo, scratch.gainTwo, wet, numThisTime);
+
+            if (fading)
+            {
+                if (interpolation == Interpolation::hermite)
+                    delayBuffer.template readGrainPair<Interpolation::hermite> (ch, scratch.fadeDelayOne, scratch.fadeGainOne,
+                                                                                scratch.fadeDelayTwo, scratch.fadeGainTwo, scratch.fadeWet, numThisTime);
+                else
+                    delayBuffer.template readGrainPair<Interpolation::linear> (ch, scratch.fadeDelayOne, scratch.fadeGainOne,
+                                                                               scratch.fadeDelayTwo, scratch.fadeGainTwo, scratch.fadeWet, numThisTime);
+
+                for (int i = 0; i < numThisTime; ++i)
+                    wet[i] += scratch.fadeWet[i];
+            }
+
+            if (compensateLatency)
+                delayDry (ch, io, numThisTime, fading);
+        }
+
+        //the mono mode only shifts the left channel, but keeps the right one's history for the stereo modes
+        if constexpr (numDelayChannels == 1)
+        {
+            if (right != nullptr && delayBuffer.getNumChannels() > 1)
+            {
+                delayBuffer.write (1, right + start, numThisTime);
+
+                if (compensateLatency)
+                    delayDry (1, right + start, numThisTime, fading);
+            }
+        }
+
+        mixWet<mode> (left, right, start, numThisTime, ramping);
+        delayBuffer.advance (numThisTime);
+    }
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::delayDry (int channel, SampleType* io, int numSamples, bool fading) noexcept
+{
+    //the block is already in the history, so it can be replaced by the input from half a window ago
+    delayBuffer.readDelayed (channel, dryDelayFor (grains.windowMs), io, numSamples);
+
+    //while the window cross-fades, the dry delay follows on the same curve
+    if (fading)
+    {
+        delayBuffer.readDelayed (channel, dryDelayFor (fadingGrains.windowMs), scratch.delayedDry, numSamples);
+
+        for (int i = 0; i < numSamples; ++i)
+            io[i] = scratch.delayedDry[i] + (SampleType) scratch.crossfade[i] * (io[i] - scratch.delayedDry[i]);
+    }
+}
+
+template <typename SampleType>
+template <OperationMode mode>
+void PitchShiftEngine<SampleType>::processVocoder (SampleType* left, SampleType* right, int numSamples) noexcept
+{
+    constexpr auto numVocoderChannels = mode == OperationMode::mono ? 1 : 2;
+
+    for (int start = 0; start < numSamples; start += grainBlockSize)
+    {
+        const auto numThisTime = std::min (grainBlockSize, numSamples - start);
+        const auto ramping = fillGainRamps (numThisTime);
+
+        //the vocoder takes a new ratio per frame, so a glide is followed block by block
+        if (pitchRatio.fillRamp (scratch.ratio, numThisTime))
+            updatePhaseIncrement();
+
+        vocoder.setPitchRatio (pitchRatio.getCurrent());
+
+        //the mono mode leaves the right channel dry, but keeps its vocoder input current for the stereo modes
+        const auto feedsRight = mode == OperationMode::mono && right != nullptr && delayBuffer.getNumChannels() > 1;
+
+        if (feedsRight)
+            std::copy (right + start, right + start + numThisTime, scratch.narrowInput[1]);
+
+        //a restarted vocoder has its input faded in, so the delayed signal doesn't start on a step
+        if (vocoderRampPosition < modeFadeLength)
+        {
+            const auto numRamped = std::min (numThisTime, modeFadeLength - vocoderRampPosition);
+
+            for (int i = 0; i < numRamped; ++i)
+            {
+                const auto ramp = (float) (vocoderRampPosition + i) / (float) modeFadeLength;
+                left[start + i] *= (SampleType) ramp;
+
+                if (numVocoderChannels > 1 && right != nullptr)
+                    right[start + i] *= (SampleType) ramp;
+
+                if (feedsRight)
+                    scratch.narrowInput[1][i] *= ramp;
+            }
+
+            vocoderRampPosition += numRamped;
+        }
+
+        if (feedsRight)
+            vocoder.writeInput (1, scratch.narrowInput[1], numThisTime);
+
+        //the vocoder hands back the input delayed to line up with its output, so the dry mix stays aligned
+        if constexpr (std::is_same_v<SampleType, float>)
+        {
+            float* io[] = { left + start, right != nullptr ? right + start : nullptr };
+            float* wet[] = { scratch.wet[0], scratch.wet[1] };
+            vocoder.process (io, wet, numVocoderChannels, numThisTime);
+        }
+        else
+        {
+            SampleType* const outputs[] = { left + start, right != nullptr ? right + start : nullptr };
+            float* io[] = { scratch.narrowInput[0], scratch.narrowInput[1] };
+            float* wet[] = { scratch.narrowWet[0], scratch.narrowWet[1] };
+
+            for (int ch = 0; ch < numVocoderChannels; ++ch)
+                std::copy (outputs[ch], outputs[ch] + numThisTime, io[ch]);
+
+            vocoder.process (io, wet, numVocoderChannels, numThisTime);
+
+            for (int ch = 0; ch < numVocoderChannels; ++ch)
+            {
+                std::copy (io[ch], io[ch] + numThisTime, outputs[ch]);
+                std::copy (wet[ch], wet[ch] + numThisTime, scratch.wet[ch]);
+            }
+        }
+
+        mixWet<mode> (left, right, start, numThisTime, ramping);
+    }
+}
+
+template <typename SampleType>
+template <OperationMode mode>
+void PitchShiftEngine<SampleType>::mixWet (SampleType* left, SampleType* right, int start, int numSamples, bool ramping) noexcept
+{
+    constexpr auto numDelayChannels = mode == OperationMode::mono || mode == OperationMode::monoBypass ? 1 : 2;
+    SampleType* const outputs[] = { left, right };
+
+    for (int ch = 0; ch < numDelayChannels; ++ch)
+    {
+        auto* io = outputs[ch] + start;
+        auto* wet = scratch.wet[ch];
+
+        if (ramping)
+        {
+            for (int i = 0; i < numSamples; ++i)
+                wet[i] = wet[i] * scratch.wetGain[i] + io[i] * scratch.dryGain[i];
+        }
+        else
+        {
+            const auto wetLevel = wetGain.getCurrent();
+            const auto dryLevel = dryGain.getCurrent();
+
+            for (int i = 0; i < numSamples; ++i)
+                wet[i] = wet[i] * wetLevel + io[i] * dryLevel;
+        }
+    }
+
+    //the steady case reads the output gain as a constant ramp of one value
+    const auto* gain = scratch.outputGain;
+    const auto level = outputGain.getCurrent();
+
+    if constexpr (mode == OperationMode::stereoDryWet)
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto g = ramping ? gain[i] : level;
+            left[start + i] = ((left[start + i] + right[start + i]) / 2.0f) * g;
+            right[start + i] = ((scratch.wet[0][i] + scratch.wet[1][i]) / 2.0f) * g;
+        }
+    }
+    else
+    {
+        for (int ch = 0; ch < numDelayChannels; ++ch)
+        {
+            if (ramping)
+                for (int i = 0; i < numSamples; ++i)
+                    outputs[ch][start + i] = scratch.wet[ch][i] * gain[i];
+            else
+                for (int i = 0; i < numSamples; ++i)
+                    outputs[ch][start + i] = scratch.wet[ch][i] * level;
+        }
+    }
+}
+
+//==============================================================================
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::processHarmonizer (SampleType* left, SampleType* right, int numSamples) noexcept
+{
+    for (int start = 0; start < numSamples; start += grainBlockSize)
+    {
+        const auto numThisTime = std::min (grainBlockSize, numSamples - start);
+        auto* inL = left + start;
+        auto* inR = right != nullptr ? right + start : nullptr;
+
+        //every voice reads the same mono history, so a voice costs taps, not a buffer
+        for (int i = 0; i < numThisTime; ++i)
+            scratch.monoInput[i] = inR != nullptr ? (inL[i] + inR[i]) * 0.5f : inL[i];
+
+        delayBuffer.write (sumChannel, scratch.monoInput, numThisTime);
+
+        //only the mono sum is read here, but the input histories are kept for the other tap modes
+        if (sumChannel != 0)
+        {
+            delayBuffer.write (0, inL, numThisTime);
+
+            if (inR != nullptr)
+                delayBuffer.write (1, inR, numThisTime);
+        }
+
+        if (interpolation == Interpolation::hermite)
+            renderHarmonyVoices<Interpolation::hermite> (numThisTime);
+        else
+            renderHarmonyVoices<Interpolation::linear> (numThisTime);
+
+        //steady gains are spread into the ramp arrays here, as the voices dominate this mode's cost
+        if (! fillGainRamps (numThisTime))
+        {
+            std::fill (scratch.dryGain, scratch.dryGain + numThisTime, dryGain.getCurrent());
+            std::fill (scratch.wetGain, scratch.wetGain + numThisTime, wetGain.getCurrent());
+            std::fill (scratch.outputGain, scratch.outputGain + numThisTime, outputGain.getCurrent());
+        }
+
+        const auto* dry = scratch.dryGain;
+        const auto* wet = scratch.wetGain;
+        const auto* gain = scratch.outputGain;
+
+        if (inR != nullptr)
+        {
+            for (int i = 0; i < numThisTime; ++i)
+            {
+                inL[i] = (inL[i] * dry[i] + scratch.wet[0][i] * wet[i]) * gain[i];
+                inR[i] = (inR[i] * dry[i] + scratch.wet[1][i] * wet[i]) * gain[i];
+            }
+        }
+        else
+        {
+            //a mono bus gets the voices unpanned
+            for (int i = 0; i < numThisTime; ++i)
+                inL[i] = (inL[i] * dry[i] + (scratch.wet[0][i] + scratch.wet[1][i]) * wet[i]) * gain[i];
+        }
+
+        delayBuffer.advance (numThisTime);
+    }
+}
+
+//==============================================================================
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::processPitchCorrection (SampleType* left, SampleType* right, int numSamples) noexcept
+{
+    //detect, then shift, one short hop at a time so the ratio follows the
+    //detector however large the host block is
+    for (int start = 0; start < numSamples; start += correctionHopSize)
+    {
+        const auto numThisTime = std::min (correctionHopSize, numSamples - start);
+        auto* inR = right != nullptr && delayBuffer.getNumChannels() > 1 ? right + start : nullptr;
+
+        if constexpr (std::is_same_v<SampleType, float>)
+        {
+            detector.process (left + start, inR, numThisTime);
+        }
+        else
+        {
+            //the detector only needs float, so a double engine hands it a narrowed copy
+            std::copy (left + start, left + start + numThisTime, scratch.narrowInput[0]);
+
+            if (inR != nullptr)
+                std::copy (inR, inR + numThisTime, scratch.narrowInput[1]);
+
+            detector.process (scratch.narrowInput[0], inR != nullptr ? scratch.narrowInput[1] : nullptr, numThisTime);
+        }
+        updateCorrection (numThisTime);
+
+        if (inR != nullptr)
+            processBlock<OperationMode::stereoWetWet> (left + start, inR, numThisTime);
+        else
+            processBlock<OperationMode::mono> (left + start, nullptr, numThisTime);
+    }
+}
+
+template <typename SampleType>
+void PitchShiftEngine<SampleType>::updateCorrection (int numSamples) noexcept
+{
+    //unvoiced input holds the last correction, so consonants and breaths don't retrigger a glide
+    if (const auto frequency = detector.getFrequency(); frequency > 0.0f)
+    {
+        const auto note = 69.0f + 12.0f * std::log2 (frequency / 440.0f);
+        const auto target = snapToScale (note, correctionKey, correctionScale) - note;
+
+        if (retuneSpeed <= 0.0f)
+            correctionSemitones = target;
+        else
+            correctionSemitones += (target - correctionSemitones)
+                                 * (1.0f - std::exp (-(float) numSamples / (retuneSpeed * 0.001f * (float) sampleRate)));
+    }
+
+    correctionRatio = std::exp2 ((double) correctionSemitones / 12.0);
+    updatePhaseIncrement();
+}
+
+template <typename SampleType>
+template <Interpolation interpolation>
+void PitchShiftEngine<SampleType>::renderHarmonyVoices (int numSamples) noexcept
+{
+    using simd::Vec;
+
+    const auto half = Vec::broadcast (0.5f);
+    const auto a = Vec::broadcast (smoothingCoefficient);
+    const auto windowTimesB = Vec::broadcast (msToSamps (delayWindow) * (1.0f - smoothingCoefficient));
+    const auto numActive = voices.numActive;
+    const auto numLanes = (numActive + Vec::size - 1) / Vec::size * Vec::size;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        for (int v = 0; v < numLanes; v += Vec::size)
+        {
+            const auto p = (Vec::load (voices.phase + v) + Vec::load (voices.increment + v)).fractionalPart();
+            p.store (voices.phase + v);
+
+            const auto tapOne = p * Vec::load (voices.moving + v);
+            const auto tapTwo = (tapOne + half).fractionalPart();
+
+            const auto delayOne = tapOne * windowTimesB + Vec::load (voices.lastDelayOne + v) * a;
+            const auto delayTwo = tapTwo * windowTimesB + Vec::load (voices.lastDelayTwo + v) * a;
+            delayOne.store (voices.lastDelayOne + v);
+            delayTwo.store (voices.lastDelayTwo + v);
+            delayOne.store (voices.delayOne + v);
+            delayTwo.store (voices.delayTwo + v);
+
+            simd::cosPi (tapOne - half).store (voices.gainOne + v);
+            simd::cosPi (tapTwo - half).store (voices.gainTwo + v);
+        }
+
+        auto wetL = SampleType (0), wetR = SampleType (0);
+
+        for (int v = 0; v < numActive; ++v)
+        {
+            const auto wet = delayBuffer.template read<interpolation> (sumChannel, i, voices.delayOne[v]) * voices.gainOne[v]
+                           + delayBuffer.template read<interpolation> (sumChannel, i, voices.delayTwo[v]) * voices.gainTwo[v];
+            wetL += wet * voices.gainLeft[v];
+            wetR += wet * voices.gainRight[v];
+        }
+
+        scratch.wet[0][i] = wetL;
+        scratch.wet[1][i] = wetR;
+    }
+}
+
+//==============================================================================
+template class PitchShiftEngine<float>;
+template class PitchShiftEngine<double>;
+
+} // namespace jafftune
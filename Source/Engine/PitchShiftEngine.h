@@ -0,0 +1,425 @@
+/*
+  ==============================================================================
+
+    PitchShiftEngine.h
+    Host-independent variable-rate delay pitch shifter used by Jafftune.
+
+    A phasor sweeps two delay taps (half a cycle apart) across a short delay
+    window, and each tap is faded in and out with a cosine window so the jump
+    at the end of each sweep is never heard. This is the same algorithm the
+    plugin used to run inline in processBlock, pulled out so it can be built,
+    profiled and embedded without JUCE or a plugin host.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "DelayBuffer.h"
+#include "ParameterSmoother.h"
+#include "PhaseVocoder.h"
+#include "PitchDetector.h"
+
+#include <cmath>
+
+namespace jafftune
+{
+
+//==============================================================================
+/** Channel routing, in the same order as the plugin's "Operation Mode" choices. */
+enum class OperationMode
+{
+    monoBypass = 0,     // left channel gained, right channel untouched
+    stereoBypass,       // both channels gained
+    mono,               // left channel pitch shifted
+    stereoWetWet,       // both channels pitch shifted
+    stereoDryWet,       // left = dry mono sum, right = shifted mono sum
+    harmonizer,         // mono sum feeds up to maxHarmonyVoices panned voices
+    pitchCorrection,    // both channels shifted onto the nearest scale note
+    numModes
+};
+
+/** How the mono and stereo modes shift, in the plugin's "Algorithm" order. */
+enum class Algorithm
+{
+    variableDelay = 0,  // the phasor-swept delay taps: cheap, low latency
+    phaseVocoder        // PhaseVocoder: cleaner on chords and transients, a frame of latency
+};
+
+//==============================================================================
+/**
+    Real-time pitch shifter based on a variable-rate delay.
+
+    Call prepare() before processing, then set parameters and call process()
+    from the audio thread. process() works in place on planar channel data.
+
+    SampleType is float or double and is what the audio itself is stored,
+    interpolated and mixed in. The phasor, tap delays and windows are control
+    signals and stay float in both, so they keep the full SIMD width; the
+    phase vocoder and pitch detector are float only, and a double engine
+    hands them float copies of its audio.
+*/
+template <typename SampleType>
+class PitchShiftEngine
+{
+public:
+    //==============================================================================
+    PitchShiftEngine() = default;
+
+    /** Allocates the delay buffers and resets all state. This is the only
+        call that allocates; process() and the setters never touch the heap
+        or take a lock. Not real-time safe.
+    */
+    void prepare (double newSampleRate, int maximumBlockSize, int numChannels);
+
+    /** Clears the delay buffers, phasor and smoothing state. */
+    void reset();
+
+    /** Like reset(), but as if bypassMode (monoBypass or stereoBypass) had been
+        running all along, so the next mode fades in from it rather than starting
+        outright. With isBypassed() on the engine being replaced, this lets a host
+        swap engines without a click.
+    */
+    void resetToBypass (OperationMode bypassMode);
+
+    /** True while a bypass mode is running with no fade under way, when the
+        output is just the input at the output gain.
+    */
+    bool isBypassed() const noexcept;
+
+    //==============================================================================
+    /** Ratio of output pitch to input pitch (the "Pitch Ratio" parameter).
+        Changes after prepare() glide over a short multiplicative ramp, unless
+        immediate is set: then the new ratio applies from the next sample, as
+        a note change should.
+    */
+    void setPitchRatio (float newPitchRatio, bool immediate = false);
+
+    /** Longest window setDelayWindow() will accept, in milliseconds. The delay
+        buffers are sized from this, so call it before prepare().
+    */
+    void setMaximumDelayWindow (float newMaximumDelayWindowMs);
+
+    /** Length of the window the delay taps sweep across, in milliseconds,
+        clamped to the maximum delay window. After prepare() a new window is
+        cross-faded in from the old one rather than jumping the taps; changes
+        that arrive mid-fade take over once it finishes.
+    */
+    void setDelayWindow (float newDelayWindowMs);
+
+    /** The window that keeps the phasor at or below adaptivePhasorFrequency
+        for a ratio, in milliseconds: short for small shifts (low latency),
+        long for big ones (fewer grain artifacts), rounded to whole
+        milliseconds and limited to [minimumAdaptiveWindow, longestWindowMs].
+    */
+    static float windowForRatio (float ratio, float longestWindowMs) noexcept;
+
+    static constexpr float adaptivePhasorFrequency = 5.0f;
+    static constexpr float minimumAdaptiveWindow = 10.0f;
+
+    /** Average delay of the shifted signal: half the window, in samples. */
+    int getLatencyInSamples() const noexcept    { return dryDelayFor (delayWindow); }
+
+    /** Delays the dry signal of the delay-tap modes by getLatencyInSamples(), so
+        it lines up with the shifted one once a host compensates for that
+        latency. Off by default, when the dry signal passes straight through.
+        A new window cross-fades the dry delay along with the taps.
+    */
+    void setLatencyCompensation (bool shouldCompensate);
+
+    /** Delay of a mode's whole output, dry and shifted alike: what a host should
+        be told. Bypass adds none and the vocoder always delays its dry signal to
+        match; the delay taps only count while compensating, and the harmonizer,
+        whose voices each lag differently, never does.
+    */
+    int getLatencyInSamples (OperationMode mode) const noexcept;
+
+    /** How long a mode's output keeps ringing once its input falls silent, in
+        samples: the longest tap delay, or the phase vocoder's frames.
+    */
+    int getTailLengthInSamples (OperationMode mode) const noexcept;
+
+    //==============================================================================
+    /** The phasor, taps and windows are generated this many samples at a time. */
+    static constexpr int grainBlockSize = 256;
+
+    /** Extra samples of history a tap may read beyond its delay (Hermite's older neighbours). */
+    static constexpr int interpolationMargin = 4;
+
+    /** Phasor increment per sample that shifts by ratio across a window of windowMs. */
+    static double phasorIncrement (double ratio, float windowMs, double sampleRate) noexcept;
+
+    /** Coefficient of the onePole that smooths the tap delays. StreamBank
+        shares this and the constants above, so its streams match the mono mode exactly.
+    */
+    static float delaySmoothingCoefficient (double sampleRate) noexcept;
+
+    //==============================================================================
+    /** Blocks whose peak is below this (-100 dBFS) count as silent. */
+    static constexpr float silenceThreshold = 1.0e-5f;
+
+    /** True while process() is skipping silent blocks. Once the input has been
+        silent for longer than the mode's tail, there is nothing left in the
+        delay line (or the vocoder) to hear, so the shifting stops and the
+        outputs are cleared. The first block above the threshold wakes it;
+        the history it reads from then is silent, so the taps fade in from
+        nothing just as they would have had the engine kept running.
+    */
+    bool isSleeping() const noexcept            { return sleeping; }
+
+    /** Linear gains applied to the unprocessed and pitch shifted signals.
+        Like the output gain, changes are ramped per sample, so automation
+        never steps at block boundaries whatever the block size.
+    */
+    void setMix (float newDryGain, float newWetGain);
+
+    /** Linear gain applied to the final output, ramped multiplicatively. */
+    void setOutputGain (float newOutputGain);
+
+    //==============================================================================
+    /** Most voices the harmonizer mode can run at once. */
+    static constexpr int maxHarmonyVoices = 8;
+
+    /** Number of harmonizer voices that are rendered (the rest are skipped). */
+    void setNumHarmonyVoices (int newNumVoices);
+
+    /** Pitch ratio, linear gain and pan (-1 = left, 1 = right) of one harmonizer voice. */
+    void setHarmonyVoice (int voiceIndex, float ratio, float gain, float pan);
+
+    int getNumHarmonyVoices() const noexcept    { return voices.numActive; }
+
+    //==============================================================================
+    /** Scale and key (0 = C ... 11 = B) the pitch correction mode snaps to, and
+        the time constant in milliseconds it glides onto a new note with
+        (0 = instant). The pitch ratio still applies, as a transposition on top.
+    */
+    void setPitchCorrection (Scale newScale, int newKey, float newRetuneSpeedMs);
+
+    /** Fundamental the pitch correction mode last detected, in Hz (0 = unvoiced). */
+    float getDetectedFrequency() const noexcept     { return detector.getFrequency(); }
+
+    /** Correction currently applied by the pitch correction mode, in semitones. */
+    float getCorrectionSemitones() const noexcept   { return correctionSemitones; }
+
+    /** Where the first delay tap is across its window, 0 to 1; the second tap is
+        half a window on, and each tap's gain is sin (pi * position).
+    */
+    float getPhasorPosition() const noexcept        { return (float) grains.phase; }
+
+    //==============================================================================
+    /** Selects the shifter for the mono and stereo modes. The harmonizer and
+        pitch correction always use the delay taps. A change takes effect
+        through the same fade as a change of mode.
+    */
+    void setAlgorithm (Algorithm newAlgorithm);
+
+    /** Whether prepare() builds the phase vocoder (on by default), a few hundred
+        kilobytes per channel. Without it runsPhaseVocoder() is always false and
+        every mode runs on the delay taps, whatever the algorithm and formant
+        settings. Call it before prepare().
+    */
+    void setPhaseVocoderEnabled (bool shouldEnable);
+
+    /** Frame size of the phase vocoder; a smaller frame has less latency. */
+    void setVocoderQuality (VocoderQuality newQuality);
+
+    /** Re-applies the input's spectral envelope after shifting, moved by
+        formantRatio (1 = formants stay put). Only the phase vocoder can do
+        this, so turning it on also moves the mono and stereo modes onto it.
+    */
+    void setFormantPreservation (bool shouldPreserve, float formantRatio);
+
+    /** True if process() runs this mode through the phase vocoder. */
+    bool runsPhaseVocoder (OperationMode mode) const noexcept;
+
+    /** Latency of the phase vocoder path, shifted and dry alike, in samples. */
+    int getVocoderLatencyInSamples() const noexcept     { return vocoder.getLatencyInSamples(); }
+
+    //==============================================================================
+    /** How the delay taps are interpolated at fractional delays. */
+    void setInterpolation (Interpolation newInterpolation);
+
+    float getPitchRatio() const noexcept     { return pitchRatio.getTarget(); }
+    float getDelayWindow() const noexcept    { return delayWindow; }
+    float getMaximumDelayWindow() const noexcept    { return maximumDelayWindow; }
+    double getSampleRate() const noexcept    { return sampleRate; }
+
+    //==============================================================================
+    /** Processes a block in place. Channels beyond the ones the mode uses are
+        left untouched; stereo modes fall back to their mono equivalents when
+        fewer than two channels are supplied.
+
+        A change of mode, or of the shifter a mode runs on, is never a jump:
+        the old one fades out to the dry signal over a few milliseconds and the
+        new one then fades in from it. Bypass and the vocoder don't write the
+        delay line, so a switch from them to the delay taps first keeps the old
+        mode running until the taps have a window of history to read.
+    */
+    void process (SampleType* const* channels, int numChannels, int numSamples, OperationMode mode) noexcept;
+
+private:
+    //==============================================================================
+    struct GrainScratch
+    {
+        alignas (32) float phasorTap[grainBlockSize];
+        alignas (32) float delayOne[grainBlockSize];
+        alignas (32) float delayTwo[grainBlockSize];
+        alignas (32) float gainOne[grainBlockSize];
+        alignas (32) float gainTwo[grainBlockSize];
+        alignas (32) SampleType wet[2][grainBlockSize];
+        alignas (32) SampleType monoInput[grainBlockSize];
+        alignas (32) float dryGain[grainBlockSize];
+        alignas (32) float wetGain[grainBlockSize];
+        alignas (32) float outputGain[grainBlockSize];
+        alignas (32) float ratio[grainBlockSize];
+        alignas (32) float fadeDelayOne[grainBlockSize];
+        alignas (32) float fadeDelayTwo[grainBlockSize];
+        alignas (32) float fadeGainOne[grainBlockSize];
+        alignas (32) float fadeGainTwo[grainBlockSize];
+        alignas (32) SampleType fadeWet[grainBlockSize];
+        alignas (32) SampleType fadeDry[2][grainBlockSize];
+        alignas (32) SampleType delayedDry[grainBlockSize];
+        alignas (32) float crossfade[grainBlockSize];
+
+        //float copies of the audio for the vocoder and detector, used by double engines only
+        alignas (32) float narrowInput[2][grainBlockSize];
+        alignas (32) float narrowWet[2][grainBlockSize];
+    };
+
+    /** One phasor~ and its tap pair, sweeping a particular window. */
+    struct GrainSet
+    {
+        double phase = 0.0;
+        double increment = 0.0;     // signed, so ratios above 1 sweep downwards
+        float windowMs = 22.0f;
+        float lastDelayOne = 0.0f;  // onePole state of the tap delays
+        float lastDelayTwo = 0.0f;
+    };
+
+    /** Harmonizer voice state, one lane per voice, so the per-sample phasor,
+        smoothing and window maths run across all voices in SIMD registers.
+        Only the delay reads are per voice.
+    */
+    struct HarmonyVoices
+    {
+        alignas (32) float phase[maxHarmonyVoices] {};
+        alignas (32) float increment[maxHarmonyVoices] {};
+        alignas (32) float moving[maxHarmonyVoices] {};     // 0 parks the taps of a voice at ratio 1
+        alignas (32) float lastDelayOne[maxHarmonyVoices] {};
+        alignas (32) float lastDelayTwo[maxHarmonyVoices] {};
+        alignas (32) float delayOne[maxHarmonyVoices] {};
+        alignas (32) float delayTwo[maxHarmonyVoices] {};
+        alignas (32) float gainOne[maxHarmonyVoices] {};
+        alignas (32) float gainTwo[maxHarmonyVoices] {};
+        float ratio[maxHarmonyVoices] {};
+        float gainLeft[maxHarmonyVoices] {};
+        float gainRight[maxHarmonyVoices] {};
+        int numActive = 0;
+    };
+
+    bool updateSleep (const SampleType* left, const SampleType* right, int numSamples, OperationMode mode) noexcept;
+
+    static bool readsDelayTaps (OperationMode mode, bool usesVocoder) noexcept
+    {
+        return ! usesVocoder && mode != OperationMode::monoBypass && mode != OperationMode::stereoBypass;
+    }
+
+    bool compensatesLatency (OperationMode mode, bool usesVocoder) const noexcept
+    {
+        return compensateLatency && readsDelayTaps (mode, usesVocoder) && mode != OperationMode::harmonizer;
+    }
+
+    void enterMode (OperationMode newMode, bool usesVocoder) noexcept;
+    void fadeMode (SampleType* left, SampleType* right, int numSamples, bool fadingOut) noexcept;
+    void processMode (SampleType* left, SampleType* right, int numSamples) noexcept;
+    void writeHistory (const SampleType* left, const SampleType* right, int numSamples) noexcept;
+    void writeSumHistory (const SampleType* left, const SampleType* right, int numSamples) noexcept;
+    void delayDry (int channel, SampleType* io, int numSamples, bool fading) noexcept;
+    int dryDelayFor (float windowMs) const noexcept     { return (int) std::lround (msToSamps (windowMs) * 0.5f); }
+
+    template <OperationMode mode>
+    void processBypass (SampleType* left, SampleType* right, int numSamples) noexcept;
+
+    template <OperationMode mode>
+    void processBlock (SampleType* left, SampleType* right, int numSamples) noexcept;
+
+    template <OperationMode mode>
+    void processVocoder (SampleType* left, SampleType* right, int numSamples) noexcept;
+
+    //dry/wet mix and output gain of scratch.wet into the block at start, shared by both shifters
+    template <OperationMode mode>
+    void mixWet (SampleType* left, SampleType* right, int start, int numSamples, bool ramping) noexcept;
+
+    bool computeGrains (int numSamples) noexcept;
+    void renderGrainSet (GrainSet& set, bool ratioGliding, int numSamples,
+                         float* delayOne, float* delayTwo, float* gainOne, float* gainTwo) noexcept;
+    bool fillGainRamps (int numSamples) noexcept;
+    void processHarmonizer (SampleType* left, SampleType* right, int numSamples) noexcept;
+    void processPitchCorrection (SampleType* left, SampleType* right, int numSamples) noexcept;
+    void updateCorrection (int numSamples) noexcept;
+
+    template <Interpolation interpolation>
+    void renderHarmonyVoices (int numSamples) noexcept;
+
+    float msToSamps (float valueInMs) const noexcept    { return valueInMs * (float) (sampleRate / 1000.0); }
+
+    //==============================================================================
+    double sampleRate = 44100.0;
+
+    DelayBuffer<SampleType> delayBuffer;
+    Interpolation interpolation = Interpolation::linear;
+
+    float delayWindow = 22.0f;
+    float maximumDelayWindow = 22.0f;
+    bool compensateLatency = false;
+
+    //parameters ramped per sample; the gain ramps are only written out while moving
+    ParameterSmoother<SmoothingType::multiplicative> pitchRatio { 1.0f };
+    ParameterSmoother<SmoothingType::linear> dryGain { 1.0f };
+    ParameterSmoother<SmoothingType::linear> wetGain { 0.0f };
+    ParameterSmoother<SmoothingType::multiplicative> outputGain { 1.0f };
+
+    //the grains sweeping delayWindow, and while it changes, the ones fading out on the old window
+    GrainSet grains;
+    GrainSet fadingGrains;
+    int crossfadeLength = 1;
+    int crossfadeRemaining = 0;
+
+    //onePole smoothing of the tap delays
+    float smoothingCoefficient = 0.0f;
+
+    GrainScratch scratch;
+    HarmonyVoices voices;
+
+    //consecutive silent input, and whether that has outlasted the tail
+    int silentSamples = 0;
+    bool sleeping = false;
+
+    //the mode and shifter being run, which trail the requested ones through a fade
+    OperationMode currentMode = OperationMode::numModes;
+    bool currentUsesVocoder = false;
+    int modeFadeLength = 1;
+    int modeFadePosition = 1;           // 0 = all dry, modeFadeLength = all the current mode
+    int vocoderRampPosition = 1;
+    int freshHistory = 0;               // samples of current input behind the delay line's write position
+    int sumChannel = 0;                 // history channel the harmonizer's voices read
+
+    //phase vocoder alternative for the mono and stereo modes
+    Algorithm algorithm = Algorithm::variableDelay;
+    bool preserveFormants = false;
+    bool vocoderEnabled = true;
+    PhaseVocoder vocoder;
+
+    //pitch correction
+    PitchDetector detector;
+    Scale correctionScale = Scale::chromatic;
+    int correctionKey = 0;
+    float retuneSpeed = 50.0f;
+    float correctionSemitones = 0.0f;
+    double correctionRatio = 1.0;
+
+    void updatePhaseIncrement() noexcept;
+    double incrementForRatio (double ratio, float windowMs) const noexcept;
+};
+
+} // namespace jafftune
@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+
+    SpscRing.h
+    Wait-free single-producer, single-consumer ring of trivially copyable items.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace jafftune
+{
+
+//==============================================================================
+/**
+    Fixed-capacity FIFO between exactly one writing thread and one reading
+    thread, such as the audio thread publishing to the message thread.
+
+    Neither side ever blocks, allocates or retries: push() drops the item
+    when the ring is full and pop() returns false when it is empty. The
+    indices live on separate cache lines so the two threads don't contend.
+*/
+template <typename Item, int capacity>
+class SpscRing
+{
+public:
+    //==============================================================================
+    static_assert (capacity > 0 && (capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+    static_assert (std::is_trivially_copyable<Item>::value, "items are copied in and out by value");
+
+    SpscRing() = default;
+
+    /** Producer side. Returns false, dropping the item, if the consumer has fallen a full ring behind. */
+    bool push (const Item& item) noexcept
+    {
+        const auto write = writeIndex.load (std::memory_order_relaxed);
+
+        if (write - readIndex.load (std::memory_order_acquire) == (std::uint32_t) capacity)
+            return false;
+
+        items[write & mask] = item;
+        writeIndex.store (write + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Consumer side. Returns false if there is nothing to read. */
+    bool pop (Item& item) noexcept
+    {
+        const auto read = readIndex.load (std::memory_order_relaxed);
+
+        if (read == writeIndex.load (std::memory_order_acquire))
+            return false;
+
+        item = items[read & mask];
+        readIndex.store (read + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    //==============================================================================
+    static constexpr std::uint32_t mask = (std::uint32_t) capacity - 1;
+
+    //free-running indices; their difference is the number of items waiting
+    alignas (64) std::atomic<std::uint32_t> writeIndex { 0 };
+    alignas (64) std::atomic<std::uint32_t> readIndex { 0 };
+    alignas (64) std::array<Item, (std::size_t) capacity> items {};
+
+    SpscRing (const SpscRing&) = delete;
+    SpscRing& operator= (const SpscRing&) = delete;
+};
+
+} // namespace jafftune
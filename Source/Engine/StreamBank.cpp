@@ -0,0 +1,291 @@
+/*
+  ==============================================================================
+
+    StreamBank.cpp
+    Many independent mono streams through the delay-tap shifter at once.
+
+  ==============================================================================
+*/
+
+#include "StreamBank.h"
+#include "PitchShiftEngine.h"
+#include "VectorOps.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace jafftune
+{
+
+namespace
+{
+    using Engine = PitchShiftEngine<float>;
+}
+
+//==============================================================================
+/** The streams sharing one pass of the vector code. */
+struct StreamBank::Lanes
+{
+    static constexpr int size = simd::Vec::size;
+
+    int count = 0;
+    int stream[size];
+    float* block[size];
+};
+
+//==============================================================================
+void StreamBank::prepare (double newSampleRate, int maximumStreams, float maximumDelayWindowMs)
+{
+    sampleRate = newSampleRate;
+    maximumWindow = std::max (1.0f, maximumDelayWindowMs);
+    smoothingCoefficient = Engine::delaySmoothingCoefficient (sampleRate);
+
+    //the same history as the engine keeps per channel
+    const auto maximumDelayInSamples = (int) std::ceil (maximumWindow * (float) (sampleRate / 1000.0));
+    const auto minimumCapacity = maximumDelayInSamples + Engine::grainBlockSize + Engine::interpolationMargin;
+
+    capacity = 1;
+    while (capacity < minimumCapacity)
+        capacity <<= 1;
+
+    mask = capacity - 1;
+
+    const auto numStreams = (size_t) std::max (0, maximumStreams);
+    history.assign (numStreams * (size_t) capacity, 0.0f);
+
+    phase.assign (numStreams, 0.0);
+    increment.assign (numStreams, 0.0);
+    windowInSamples.assign (numStreams, 0.0f);
+    lastDelayOne.assign (numStreams, 0.0f);
+    lastDelayTwo.assign (numStreams, 0.0f);
+    dryGain.assign (numStreams, 0.0f);
+    wetGain.assign (numStreams, 0.0f);
+    outputGain.assign (numStreams, 0.0f);
+    writePosition.assign (numStreams, 0);
+    tailLength.assign (numStreams, 0);
+    silentSamples.assign (numStreams, 0);
+    sleeping.assign (numStreams, 0);
+    usesHermite.assign (numStreams, 0);
+    isOpen.assign (numStreams, 0);
+    numOpen = 0;
+}
+
+int StreamBank::openStream (const StreamSettings& settings) noexcept
+{
+    const auto free = std::find (isOpen.begin(), isOpen.end(), (unsigned char) 0);
+
+    if (free == isOpen.end())
+        return -1;
+
+    const auto s = (int) (free - isOpen.begin());
+    const auto window = std::clamp (settings.delayWindowMs, 0.1f, maximumWindow);
+    const auto windowSamples = window * (float) (sampleRate / 1000.0);
+
+    //a freshly prepared engine: empty history, phasor at zero, parameters already at their targets
+    auto* ring = history.data() + (size_t) s * (size_t) capacity;
+    std::fill (ring, ring + capacity, 0.0f);
+
+    phase[(size_t) s] = 0.0;
+    increment[(size_t) s] = Engine::phasorIncrement ((double) settings.pitchRatio, window, sampleRate);
+    windowInSamples[(size_t) s] = windowSamples;
+    lastDelayOne[(size_t) s] = 0.0f;
+    lastDelayTwo[(size_t) s] = 0.0f;
+    dryGain[(size_t) s] = settings.dryGain;
+    wetGain[(size_t) s] = settings.wetGain;
+    outputGain[(size_t) s] = settings.outputGain;
+    writePosition[(size_t) s] = 0;
+    tailLength[(size_t) s] = (int) std::ceil (windowSamples) + Engine::interpolationMargin;
+    silentSamples[(size_t) s] = 0;
+    sleeping[(size_t) s] = 0;
+    usesHermite[(size_t) s] = settings.interpolation == Interpolation::hermite ? 1 : 0;
+    isOpen[(size_t) s] = 1;
+
+    ++numOpen;
+    return s;
+}
+
+void StreamBank::closeStream (int stream) noexcept
+{
+    if (stream < 0 || stream >= getMaximumStreams() || isOpen[(size_t) stream] == 0)
+        return;
+
+    isOpen[(size_t) stream] = 0;
+    --numOpen;
+}
+
+int StreamBank::getLatencyInSamples (int stream) const noexcept
+{
+    return (int) std::lround (windowInSamples[(size_t) stream] * 0.5f);
+}
+
+//==============================================================================
+void StreamBank::process (const int* streams, float* const* blocks, int numStreams, int numSamples) noexcept
+{
+    Lanes lanes;
+
+    for (int n = 0; n < numStreams; ++n)
+    {
+        if (updateSleep (streams[n], blocks[n], numSamples))
+        {
+            std::fill (blocks[n], blocks[n] + numSamples, 0.0f);
+            continue;
+        }
+
+        lanes.stream[lanes.count] = streams[n];
+        lanes.block[lanes.count] = blocks[n];
+
+        if (++lanes.count == Lanes::size)
+        {
+            processLanes (lanes, numSamples);
+            lanes.count = 0;
+        }
+    }
+
+    if (lanes.count > 0)
+        processLanes (lanes, numSamples);
+}
+
+bool StreamBank::updateSleep (int stream, const float* block, int numSamples) noexcept
+{
+    //PitchShiftEngine::updateSleep for the mono mode
+    const auto s = (size_t) stream;
+
+    if (simd::peakMagnitude (block, numSamples) >= Engine::silenceThreshold)
+    {
+        silentSamples[s] = 0;
+        sleeping[s] = 0;
+        return false;
+    }
+
+    if (sleeping[s] != 0)
+        return true;
+
+    silentSamples[s] = std::min (silentSamples[s] + numSamples, 1 << 30);
+    sleeping[s] = silentSamples[s] > tailLength[s] ? 1 : 0;
+    return false;
+}
+
+void StreamBank::processLanes (Lanes& lanes, int numSamples) noexcept
+{
+    using simd::Vec;
+    constexpr auto width = Lanes::size;
+    constexpr auto chunkSize = Engine::grainBlockSize;
+
+    //unused lanes run on zeros and are never read from or written back
+    alignas (32) double lanePhase[width] = {};
+    alignas (32) double laneIncrement[width] = {};
+    alignas (32) float window[width] = {};
+    alignas (32) float lastOne[width] = {};
+    alignas (32) float lastTwo[width] = {};
+    float* rings[width] = {};
+
+    //a chunk of taps for every lane, sample-major so each sample is one vector store
+    alignas (32) float tap[width];
+    alignas (32) float delayOne[chunkSize * width];
+    alignas (32) float delayTwo[chunkSize * width];
+    alignas (32) float gainOne[chunkSize * width];
+    alignas (32) float gainTwo[chunkSize * width];
+
+    for (int l = 0; l < lanes.count; ++l)
+    {
+        const auto s = (size_t) lanes.stream[l];
+        lanePhase[l] = phase[s];
+        laneIncrement[l] = increment[s];
+        window[l] = windowInSamples[s];
+        lastOne[l] = lastDelayOne[s];
+        lastTwo[l] = lastDelayTwo[s];
+        rings[l] = history.data() + s * (size_t) capacity;
+    }
+
+    const auto a = Vec::broadcast (smoothingCoefficient);
+    const auto b = Vec::broadcast (1.0f - smoothingCoefficient);
+    const auto windows = Vec::load (window);
+    auto smoothedOne = Vec::load (lastOne);
+    auto smoothedTwo = Vec::load (lastTwo);
+
+    //the engine's chunks, so each phasor ramp starts from the same sample
+    for (int start = 0; start < numSamples; start += chunkSize)
+    {
+        const auto numThisTime = std::min (chunkSize, numSamples - start);
+
+        //simd::fillPhasorRamp's choice of wrap, made once for every lane
+        auto withinCycle = true;
+
+        for (int l = 0; l < width; ++l)
+            withinCycle = withinCycle && simd::phasorWithinCycle (laneIncrement[l], numThisTime);
+
+        //the engine's phasor, grain taps and onePole, one stream per lane
+        for (int i = 0; i < numThisTime; ++i)
+        {
+            for (int l = 0; l < width; ++l)
+                tap[l] = laneIncrement[l] != 0.0 ? simd::phasorAt (lanePhase[l], laneIncrement[l], i + 1, withinCycle) : 0.0f;
+
+            const auto taps = simd::grainTaps (Vec::load (tap), windows);
+
+            smoothedOne = simd::onePole (taps.delayOne, smoothedOne, a, b);
+            smoothedTwo = simd::onePole (taps.delayTwo, smoothedTwo, a, b);
+            smoothedOne.store (delayOne + i * width);
+            smoothedTwo.store (delayTwo + i * width);
+            taps.gainOne.store (gainOne + i * width);
+            taps.gainTwo.store (gainTwo + i * width);
+        }
+
+        for (int l = 0; l < lanes.count; ++l)
+        {
+            const auto s = (size_t) lanes.stream[l];
+            auto* io = lanes.block[l] + start;
+            auto* ring = rings[l];
+            const auto position = writePosition[s];
+
+            //DelayBuffer::write, then readGrainPair and PitchShiftEngine::mixWet at steady gains
+            const auto firstPart = std::min (numThisTime, capacity - position);
+            std::copy (io, io + firstPart, ring + position);
+            std::copy (io + firstPart, io + numThisTime, ring);
+
+            const auto wetLevel = wetGain[s];
+            const auto dryLevel = dryGain[s];
+            const auto level = outputGain[s];
+
+            if (usesHermite[s] != 0)
+            {
+                for (int i = 0; i < numThisTime; ++i)
+                {
+                    const auto n = i * width + l;
+                    const auto shifted = readDelayTap<Interpolation::hermite> (ring, mask, position + i, delayOne[n]) * gainOne[n]
+                                       + readDelayTap<Interpolation::hermite> (ring, mask, position + i, delayTwo[n]) * gainTwo[n];
+                    const auto wet = shifted * wetLevel + io[i] * dryLevel;
+                    io[i] = wet * level;
+                }
+            }
+            else
+            {
+                for (int i = 0; i < numThisTime; ++i)
+                {
+                    const auto n = i * width + l;
+                    const auto shifted = readDelayTap<Interpolation::linear> (ring, mask, position + i, delayOne[n]) * gainOne[n]
+                                       + readDelayTap<Interpolation::linear> (ring, mask, position + i, delayTwo[n]) * gainTwo[n];
+                    const auto wet = shifted * wetLevel + io[i] * dryLevel;
+                    io[i] = wet * level;
+                }
+            }
+
+            writePosition[s] = (position + numThisTime) & mask;
+        }
+
+        for (int l = 0; l < width; ++l)
+            lanePhase[l] = simd::advancePhase (lanePhase[l], laneIncrement[l], numThisTime);
+    }
+
+    smoothedOne.store (lastOne);
+    smoothedTwo.store (lastTwo);
+
+    for (int l = 0; l < lanes.count; ++l)
+    {
+        const auto s = (size_t) lanes.stream[l];
+        phase[s] = lanePhase[l];
+        lastDelayOne[s] = lastOne[l];
+        lastDelayTwo[s] = lastTwo[l];
+    }
+}
+
+} // namespace jafftune
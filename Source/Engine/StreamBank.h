@@ -0,0 +1,118 @@
+/*
+  ==============================================================================
+
+    StreamBank.h
+    Many independent mono streams through the delay-tap shifter at once.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "DelayBuffer.h"
+
+#include <vector>
+
+namespace jafftune
+{
+
+//==============================================================================
+/** What a stream is opened with. These stay fixed for the stream's lifetime. */
+struct StreamSettings
+{
+    float pitchRatio = 1.0f;
+    float dryGain = 0.0f;
+    float wetGain = 1.0f;
+    float outputGain = 1.0f;
+    float delayWindowMs = 22.0f;
+    Interpolation interpolation = Interpolation::linear;
+};
+
+//==============================================================================
+/**
+    Runs PitchShiftEngine's mono mode for up to maximumStreams streams without
+    an engine apiece.
+
+    Each stream costs its delay history and a few values of state. The
+    histories share one contiguous allocation and the state is kept as
+    structure-of-arrays, indexed by stream. Streams are processed Vec::size
+    at a time: their phasors, tap windows and delay smoothing go through the
+    engine's own simd:: steps in parallel lanes, and each lane reads its own
+    history.
+
+    Every step is the same arithmetic, in the same order and the same
+    grain-block chunks, as the engine's, so a stream's output is bit for bit
+    what a PitchShiftEngine<float> prepared with its settings would produce
+    in OperationMode::mono. That includes sleeping on silent input. The
+    settings being fixed, nothing here ever glides or cross-fades.
+*/
+class StreamBank
+{
+public:
+    //==============================================================================
+    StreamBank() = default;
+
+    /** Allocates room for maximumStreams streams with windows up to
+        maximumDelayWindowMs and closes any open streams. Not real-time safe.
+    */
+    void prepare (double newSampleRate, int maximumStreams, float maximumDelayWindowMs);
+
+    /** Claims a free stream, clears its history and returns its index, or -1 if all are open. */
+    int openStream (const StreamSettings& settings) noexcept;
+
+    /** Frees a stream for reuse. */
+    void closeStream (int stream) noexcept;
+
+    int getNumOpenStreams() const noexcept      { return numOpen; }
+    int getMaximumStreams() const noexcept      { return (int) isOpen.size(); }
+    double getSampleRate() const noexcept       { return sampleRate; }
+
+    /** Average delay of a stream's shifted signal, as PitchShiftEngine::getLatencyInSamples(). */
+    int getLatencyInSamples (int stream) const noexcept;
+
+    //==============================================================================
+    /** Processes one block of numSamples in place for each of numStreams open
+        streams. Never allocates. Calls on different threads may overlap as
+        long as they name different streams.
+    */
+    void process (const int* streams, float* const* blocks, int numStreams, int numSamples) noexcept;
+
+private:
+    //==============================================================================
+    struct Lanes;
+
+    bool updateSleep (int stream, const float* block, int numSamples) noexcept;
+    void processLanes (Lanes& lanes, int numSamples) noexcept;
+
+    //==============================================================================
+    double sampleRate = 44100.0;
+    float maximumWindow = 22.0f;
+    float smoothingCoefficient = 0.0f;
+    int numOpen = 0;
+
+    //every stream's history, one power-of-two ring after another
+    std::vector<float> history;
+    int capacity = 0;
+    int mask = 0;
+
+    //per-stream state, by stream index
+    std::vector<double> phase;
+    std::vector<double> increment;
+    std::vector<float> windowInSamples;
+    std::vector<float> lastDelayOne;
+    std::vector<float> lastDelayTwo;
+    std::vector<float> dryGain;
+    std::vector<float> wetGain;
+    std::vector<float> outputGain;
+    std::vector<int> writePosition;
+    std::vector<int> tailLength;
+    std::vector<int> silentSamples;
+    std::vector<unsigned char> sleeping;
+    std::vector<unsigned char> usesHermite;
+    std::vector<unsigned char> isOpen;
+
+    StreamBank (const StreamBank&) = delete;
+    StreamBank& operator= (const StreamBank&) = delete;
+};
+
+} // namespace jafftune
@@ -0,0 +1,396 @@
+/*
+  ==============================================================================
+
+    VectorOps.h
+    Block-wise SIMD helpers for the pitch shifter's phasor, grain windows,
+    bypass gain and silence detection.
+
+    Picks AVX, SSE2 or NEON at compile time and falls back to plain scalar
+    code elsewhere, so the engine itself stays free of intrinsics.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#if defined (__AVX__)
+ #include <immintrin.h>
+ #define JAFFTUNE_SIMD_AVX 1
+#elif defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define JAFFTUNE_SIMD_SSE 1
+#elif defined (__ARM_NEON) || defined (__ARM_NEON__) || defined (_M_ARM64)
+ #include <arm_neon.h>
+ #define JAFFTUNE_SIMD_NEON 1
+#endif
+
+namespace jafftune
+{
+namespace simd
+{
+
+//==============================================================================
+/** A minimal float register wrapper: just the operations the grain kernels need. */
+struct Vec
+{
+   #if JAFFTUNE_SIMD_AVX
+    static constexpr int size = 8;
+    __m256 v;
+
+    static Vec load (const float* p) noexcept          { return { _mm256_loadu_ps (p) }; }
+    void store (float* p) const noexcept                { _mm256_storeu_ps (p, v); }
+    static Vec broadcast (float x) noexcept             { return { _mm256_set1_ps (x) }; }
+    Vec operator+ (Vec o) const noexcept                { return { _mm256_add_ps (v, o.v) }; }
+    Vec operator- (Vec o) const noexcept                { return { _mm256_sub_ps (v, o.v) }; }
+    Vec operator* (Vec o) const noexcept                { return { _mm256_mul_ps (v, o.v) }; }
+    static Vec floor (Vec a) noexcept                   { return { _mm256_floor_ps (a.v) }; }
+    static Vec abs (Vec a) noexcept                     { return { _mm256_andnot_ps (_mm256_set1_ps (-0.0f), a.v) }; }
+    static Vec max (Vec a, Vec b) noexcept              { return { _mm256_max_ps (a.v, b.v) }; }
+
+   #elif JAFFTUNE_SIMD_SSE
+    static constexpr int size = 4;
+    __m128 v;
+
+    static Vec load (const float* p) noexcept          { return { _mm_loadu_ps (p) }; }
+    void store (float* p) const noexcept                { _mm_storeu_ps (p, v); }
+    static Vec broadcast (float x) noexcept             { return { _mm_set1_ps (x) }; }
+    Vec operator+ (Vec o) const noexcept                { return { _mm_add_ps (v, o.v) }; }
+    Vec operator- (Vec o) const noexcept                { return { _mm_sub_ps (v, o.v) }; }
+    Vec operator* (Vec o) const noexcept                { return { _mm_mul_ps (v, o.v) }; }
+    static Vec abs (Vec a) noexcept                     { return { _mm_andnot_ps (_mm_set1_ps (-0.0f), a.v) }; }
+    static Vec max (Vec a, Vec b) noexcept              { return { _mm_max_ps (a.v, b.v) }; }
+
+    static Vec floor (Vec a) noexcept
+    {
+        //truncate, then step down where truncation rounded a negative value up
+        const auto truncated = _mm_cvtepi32_ps (_mm_cvttps_epi32 (a.v));
+        return { _mm_sub_ps (truncated, _mm_and_ps (_mm_cmpgt_ps (truncated, a.v), _mm_set1_ps (1.0f))) };
+    }
+
+   #elif JAFFTUNE_SIMD_NEON
+    static constexpr int size = 4;
+    float32x4_t v;
+
+    static Vec load (const float* p) noexcept          { return { vld1q_f32 (p) }; }
+    void store (float* p) const noexcept                { vst1q_f32 (p, v); }
+    static Vec broadcast (float x) noexcept             { return { vdupq_n_f32 (x) }; }
+    Vec operator+ (Vec o) const noexcept                { return { vaddq_f32 (v, o.v) }; }
+    Vec operator- (Vec o) const noexcept                { return { vsubq_f32 (v, o.v) }; }
+    Vec operator* (Vec o) const noexcept                { return { vmulq_f32 (v, o.v) }; }
+    static Vec abs (Vec a) noexcept                     { return { vabsq_f32 (a.v) }; }
+    static Vec max (Vec a, Vec b) noexcept              { return { vmaxq_f32 (a.v, b.v) }; }
+
+    static Vec floor (Vec a) noexcept
+    {
+       #if defined (__aarch64__) || defined (_M_ARM64)
+        return { vrndmq_f32 (a.v) };
+       #else
+        const auto truncated = vcvtq_f32_s32 (vcvtq_s32_f32 (a.v));
+        const auto roundedUp = vcgtq_f32 (truncated, a.v);
+        return { vsubq_f32 (truncated, vreinterpretq_f32_u32 (vandq_u32 (roundedUp, vreinterpretq_u32_f32 (vdupq_n_f32 (1.0f))))) };
+       #endif
+    }
+
+   #else
+    static constexpr int size = 1;
+    float v;
+
+    static Vec load (const float* p) noexcept          { return { *p }; }
+    void store (float* p) const noexcept                { *p = v; }
+    static Vec broadcast (float x) noexcept             { return { x }; }
+    Vec operator+ (Vec o) const noexcept                { return { v + o.v }; }
+    Vec operator- (Vec o) const noexcept                { return { v - o.v }; }
+    Vec operator* (Vec o) const noexcept                { return { v * o.v }; }
+    static Vec floor (Vec a) noexcept                   { return { std::floor (a.v) }; }
+    static Vec abs (Vec a) noexcept                     { return { std::abs (a.v) }; }
+    static Vec max (Vec a, Vec b) noexcept              { return { std::max (a.v, b.v) }; }
+   #endif
+
+    /** start, start + step, start + 2 * step, ... across the lanes. */
+    static Vec ramp (float start, float step) noexcept
+    {
+        alignas (32) static constexpr float laneIndex[] = { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f };
+        return broadcast (start) + load (laneIndex) * broadcast (step);
+    }
+
+    Vec fractionalPart() const noexcept                 { return *this - floor (*this); }
+};
+
+//==============================================================================
+/** cos (pi * u) for |u| <= 0.5, as a degree-10 even polynomial.
+
+    Absolute error against std::cos is below 5e-7 over the whole range, which
+    is under the float rounding of the samples the windows are applied to.
+*/
+inline Vec cosPi (Vec u) noexcept
+{
+    const auto u2 = u * u;
+    auto p = Vec::broadcast (-0.02580689139001405f);
+    p = p * u2 + Vec::broadcast (0.23533063035889312f);
+    p = p * u2 + Vec::broadcast (-1.3352627688545893f);
+    p = p * u2 + Vec::broadcast (4.058712126416768f);
+    p = p * u2 + Vec::broadcast (-4.934802200544679f);
+    return p * u2 + Vec::broadcast (1.0f);
+}
+
+inline float cosPi (float u) noexcept
+{
+    const auto u2 = u * u;
+    return ((((-0.02580689139001405f * u2 + 0.23533063035889312f) * u2 - 1.3352627688545893f) * u2
+               + 4.058712126416768f) * u2 - 4.934802200544679f) * u2 + 1.0f;
+}
+
+//==============================================================================
+/** Narrows a wrapped phase to float, folding values that round up to 1 back to 0. */
+inline float toUnitPhase (double wrappedPhase) noexcept
+{
+    const auto narrowed = (float) wrappedPhase;
+    return narrowed < 1.0f ? narrowed : 0.0f;
+}
+
+/** True if a phasor can't cross a whole cycle in numSamples, so phasorAt() can wrap cheaply. */
+inline bool phasorWithinCycle (double increment, int numSamples) noexcept
+{
+    return std::abs (increment) * numSamples < 1.0;
+}
+
+/** The phasor~ output index increments on from phase: wrapped to [0, 1)
+    and narrowed. Within a cycle the wrap is a compare-and-subtract, which is
+    what floor gives in that range.
+*/
+inline float phasorAt (double phase, double increment, int index, bool withinCycle) noexcept
+{
+    auto value = phase + (double) index * increment;
+
+    if (withinCycle)
+    {
+        value -= value >= 1.0 ? 1.0 : 0.0;
+        value += value < 0.0 ? 1.0 : 0.0;
+    }
+    else
+    {
+        value -= std::floor (value);
+    }
+
+    return toUnitPhase (value);
+}
+
+/** The phase numSamples increments on from phase, wrapped to [0, 1). */
+inline double advancePhase (double phase, double increment, int numSamples) noexcept
+{
+    const auto next = phase + (double) numSamples * increment;
+    return next - std::floor (next);
+}
+
+/** Writes numSamples of phasor~ output (the phase after each increment,
+    wrapped to [0, 1)) and returns the phase to continue from next block.
+
+    The ramp is built in double so the sample a grain wraps on never drifts
+    from a per-sample accumulator; as long as a block spans less than one
+    phasor cycle the wrap is a compare-and-subtract the compiler vectorizes.
+*/
+inline double fillPhasorRamp (float* dest, int numSamples, double phase, double increment) noexcept
+{
+    const auto withinCycle = phasorWithinCycle (increment, numSamples);
+    int i = 0;
+
+    if (withinCycle)
+    {
+       #if JAFFTUNE_SIMD_AVX || JAFFTUNE_SIMD_SSE
+        const auto start = _mm_set1_pd (phase);
+        const auto step = _mm_set1_pd (increment);
+        const auto one = _mm_set1_pd (1.0);
+        const auto zero = _mm_setzero_pd();
+        const auto oneF = _mm_set1_ps (1.0f);
+
+        auto wrap = [&] (__m128d index)
+        {
+            auto value = _mm_add_pd (start, _mm_mul_pd (index, step));
+            value = _mm_sub_pd (value, _mm_and_pd (_mm_cmpge_pd (value, one), one));
+            return _mm_add_pd (value, _mm_and_pd (_mm_cmplt_pd (value, zero), one));
+        };
+
+        const auto four = _mm_set1_pd (4.0);
+        auto lowIndex = _mm_set_pd (2.0, 1.0);
+        auto highIndex = _mm_set_pd (4.0, 3.0);
+
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            const auto narrowed = _mm_movelh_ps (_mm_cvtpd_ps (wrap (lowIndex)), _mm_cvtpd_ps (wrap (highIndex)));
+            _mm_storeu_ps (dest + i, _mm_and_ps (narrowed, _mm_cmplt_ps (narrowed, oneF)));
+
+            lowIndex = _mm_add_pd (lowIndex, four);
+            highIndex = _mm_add_pd (highIndex, four);
+        }
+       #elif JAFFTUNE_SIMD_NEON && (defined (__aarch64__) || defined (_M_ARM64))
+        const auto start = vdupq_n_f64 (phase);
+        const auto step = vdupq_n_f64 (increment);
+        const auto one = vdupq_n_f64 (1.0);
+        const auto zero = vdupq_n_f64 (0.0);
+        const auto oneF = vdupq_n_f32 (1.0f);
+
+        auto wrap = [&] (float64x2_t index)
+        {
+            auto value = vfmaq_f64 (start, index, step);
+            value = vsubq_f64 (value, vreinterpretq_f64_u64 (vandq_u64 (vcgeq_f64 (value, one), vreinterpretq_u64_f64 (one))));
+            return vaddq_f64 (value, vreinterpretq_f64_u64 (vandq_u64 (vcltq_f64 (value, zero), vreinterpretq_u64_f64 (one))));
+        };
+
+        const auto four = vdupq_n_f64 (4.0);
+        const double firstIndices[] = { 1.0, 2.0, 3.0, 4.0 };
+        auto lowIndex = vld1q_f64 (firstIndices);
+        auto highIndex = vld1q_f64 (firstIndices + 2);
+
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            const auto narrowed = vcombine_f32 (vcvt_f32_f64 (wrap (lowIndex)), vcvt_f32_f64 (wrap (highIndex)));
+            vst1q_f32 (dest + i, vreinterpretq_f32_u32 (vandq_u32 (vreinterpretq_u32_f32 (narrowed), vcltq_f32 (narrowed, oneF))));
+
+            lowIndex = vaddq_f64 (lowIndex, four);
+            highIndex = vaddq_f64 (highIndex, four);
+        }
+       #endif
+    }
+
+    for (; i < numSamples; ++i)
+        dest[i] = phasorAt (phase, increment, i + 1, withinCycle);
+
+    return advancePhase (phase, increment, numSamples);
+}
+
+/** One vector of grain taps: each tap's delay in samples and its window gain. */
+struct GrainTaps
+{
+    Vec delayOne, delayTwo, gainOne, gainTwo;
+};
+
+/** The grain taps for a vector of phasor~ output, with tap two half a cycle
+    behind tap one. The lanes may be samples of one phasor or separate ones.
+*/
+inline GrainTaps grainTaps (Vec tapOne, Vec windowInSamples) noexcept
+{
+    const auto half = Vec::broadcast (0.5f);
+    const auto tapTwo = (tapOne + half).fractionalPart();
+
+    return { tapOne * windowInSamples, tapTwo * windowInSamples, cosPi (tapOne - half), cosPi (tapTwo - half) };
+}
+
+/** Turns a block of phasor~ output into the two grain taps: each tap's
+    delay in samples and its cosine window gain. Tap two runs half a cycle
+    behind tap one.
+*/
+inline void computeGrainTaps (const float* phasorTap, float* delayOne, float* delayTwo,
+                              float* gainOne, float* gainTwo, int numSamples, float windowInSamples) noexcept
+{
+    const auto window = Vec::broadcast (windowInSamples);
+    int i = 0;
+
+    for (; i + Vec::size <= numSamples; i += Vec::size)
+    {
+        const auto taps = grainTaps (Vec::load (phasorTap + i), window);
+
+        taps.delayOne.store (delayOne + i);
+        taps.delayTwo.store (delayTwo + i);
+        taps.gainOne.store (gainOne + i);
+        taps.gainTwo.store (gainTwo + i);
+    }
+
+    for (; i < numSamples; ++i)
+    {
+        const auto tapOne = phasorTap[i];
+        const auto offset = tapOne + 0.5f;
+        const auto tapTwo = offset - std::floor (offset);
+
+        delayOne[i] = tapOne * windowInSamples;
+        delayTwo[i] = tapTwo * windowInSamples;
+        gainOne[i] = cosPi (tapOne - 0.5f);
+        gainTwo[i] = cosPi (tapTwo - 0.5f);
+    }
+}
+
+/** One step of the onePole that smooths a tap delay, a = the smoothing
+    coefficient and b = 1 - a. A single multiply-add, so a recursion over
+    samples is one dependent op per step.
+*/
+inline float onePole (float input, float last, float a, float b) noexcept     { return input * b + last * a; }
+inline Vec onePole (Vec input, Vec last, Vec a, Vec b) noexcept               { return input * b + last * a; }
+
+//==============================================================================
+/** data[i] *= gain, in place. */
+inline void applyGain (float* data, int numSamples, float gain) noexcept
+{
+    const auto g = Vec::broadcast (gain);
+    int i = 0;
+
+    for (; i + Vec::size <= numSamples; i += Vec::size)
+        (Vec::load (data + i) * g).store (data + i);
+
+    for (; i < numSamples; ++i)
+        data[i] *= gain;
+}
+
+/** data[i] *= gains[i], in place. */
+inline void applyGainRamp (float* data, const float* gains, int numSamples) noexcept
+{
+    int i = 0;
+
+    for (; i + Vec::size <= numSamples; i += Vec::size)
+        (Vec::load (data + i) * Vec::load (gains + i)).store (data + i);
+
+    for (; i < numSamples; ++i)
+        data[i] *= gains[i];
+}
+
+/** The double versions; Vec only holds floats, so these are left to the compiler. */
+inline void applyGain (double* data, int numSamples, float gain) noexcept
+{
+    for (int i = 0; i < numSamples; ++i)
+        data[i] *= gain;
+}
+
+inline void applyGainRamp (double* data, const float* gains, int numSamples) noexcept
+{
+    for (int i = 0; i < numSamples; ++i)
+        data[i] *= gains[i];
+}
+
+//==============================================================================
+/** Largest absolute sample value in a block, for the engine's silence check. */
+inline float peakMagnitude (const float* data, int numSamples) noexcept
+{
+    auto peaks = Vec::broadcast (0.0f);
+    int i = 0;
+
+    for (; i + Vec::size <= numSamples; i += Vec::size)
+        peaks = Vec::max (peaks, Vec::abs (Vec::load (data + i)));
+
+    alignas (32) float lanes[Vec::size];
+    peaks.store (lanes);
+
+    auto peak = 0.0f;
+
+    for (auto lane : lanes)
+        peak = std::max (peak, lane);
+
+    for (; i < numSamples; ++i)
+        peak = std::max (peak, std::abs (data[i]));
+
+    return peak;
+}
+
+/** The same for double blocks. */
+inline double peakMagnitude (const double* data, int numSamples) noexcept
+{
+    auto peak = 0.0;
+
+    for (int i = 0; i < numSamples; ++i)
+        peak = std::max (peak, std::abs (data[i]));
+
+    return peak;
+}
+
+} // namespace simd
+} // namespace jafftune
@@ -0,0 +1,249 @@
+/*
+  ==============================================================================
+
+    WorkerPool.cpp
+    Small fixed pool of threads that help the audio thread with parallel work.
+
+  ==============================================================================
+*/
+
+#include "WorkerPool.h"
+
+#include <chrono>
+#include <climits>
+#include <cerrno>
+
+#if defined (_WIN32)
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#else
+ #include <pthread.h>
+ #include <sched.h>
+ #if defined (__APPLE__)
+  #include <dispatch/dispatch.h>
+ #else
+  #include <semaphore.h>
+ #endif
+#endif
+
+namespace jafftune
+{
+
+namespace
+{
+    //how long an idle worker polls for a new batch before it goes to sleep: long enough
+    //to catch the next task of a busy batch, far shorter than any audio callback period
+    constexpr auto idleSpinTime = std::chrono::microseconds (50);
+}
+
+//==============================================================================
+struct WorkerPool::Semaphore
+{
+   #if defined (_WIN32)
+    Semaphore() noexcept                    { handle = CreateSemaphore (nullptr, 0, LONG_MAX, nullptr); }
+    ~Semaphore()                            { CloseHandle (handle); }
+    void post (int count) noexcept          { ReleaseSemaphore (handle, count, nullptr); }
+    void wait() noexcept                    { WaitForSingleObject (handle, INFINITE); }
+
+    HANDLE handle;
+   #elif defined (__APPLE__)
+    Semaphore() noexcept                    { handle = dispatch_semaphore_create (0); }
+    ~Semaphore()                            { dispatch_release (handle); }
+    void post (int count) noexcept          { while (--count >= 0) dispatch_semaphore_signal (handle); }
+    void wait() noexcept                    { dispatch_semaphore_wait (handle, DISPATCH_TIME_FOREVER); }
+
+    dispatch_semaphore_t handle;
+   #else
+    Semaphore() noexcept                    { sem_init (&handle, 0, 0); }
+    ~Semaphore()                            { sem_destroy (&handle); }
+    void post (int count) noexcept          { while (--count >= 0) sem_post (&handle); }
+    void wait() noexcept                    { while (sem_wait (&handle) != 0 && errno == EINTR) {} }
+
+    sem_t handle;
+   #endif
+};
+
+//==============================================================================
+WorkerPool::WorkerPool()
+    : wakeUp (std::make_unique<Semaphore>())
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+    stop();
+}
+
+void WorkerPool::start (int numWorkers)
+{
+    stop();
+
+    shouldExit = false;
+    resetCallerSchedule();
+
+    for (int i = 0; i < numWorkers; ++i)
+        threads.emplace_back ([this] { workerLoop(); });
+}
+
+void WorkerPool::stop()
+{
+    //every worker is posted, asleep or not, so none can miss the exit
+    shouldExit = true;
+    wakeUp->post ((int) threads.size());
+
+    for (auto& thread : threads)
+        thread.join();
+
+    threads.clear();
+}
+
+//==============================================================================
+void WorkerPool::run (Task task, void* context, int numTasks) noexcept
+{
+    if (numTasks <= 0)
+        return;
+
+    auto schedule = callerSchedule.load (std::memory_order_relaxed);
+
+    if (schedule == unknownSchedule)
+    {
+        schedule = getCurrentSchedule();
+        callerSchedule.store (schedule, std::memory_order_relaxed);
+    }
+
+    //a caller whose priority the workers can't match does the whole batch, rather than wait on one
+    const auto refused = schedule != noSchedule && schedule == refusedSchedule.load (std::memory_order_relaxed);
+
+    if (threads.empty() || numTasks == 1 || refused)
+    {
+        for (int i = 0; i < numTasks; ++i)
+            task (context, i);
+
+        return;
+    }
+
+    //publish the batch: stale claims from the last one see noTasks until nextTask is released
+    currentTask.store (task, std::memory_order_relaxed);
+    currentContext.store (context, std::memory_order_relaxed);
+    batchSize.store (numTasks, std::memory_order_relaxed);
+    numFinished.store (0, std::memory_order_relaxed);
+    nextTask.store (0, std::memory_order_release);
+    generation.fetch_add (1, std::memory_order_seq_cst);
+
+    //a worker counts itself asleep before its last look at generation, so one of the two always
+    //sees the other; spinning workers need no post
+    if (const auto sleepers = numSleeping.load (std::memory_order_seq_cst); sleepers > 0)
+        wakeUp->post (sleepers);
+
+    runClaimedTasks();
+
+    //only tasks a worker has already started can be outstanding here
+    while (numFinished.load (std::memory_order_acquire) < numTasks)
+        std::this_thread::yield();
+
+    nextTask.store (noTasks, std::memory_order_relaxed);
+}
+
+void WorkerPool::runClaimedTasks() noexcept
+{
+    for (;;)
+    {
+        const auto index = nextTask.fetch_add (1, std::memory_order_acq_rel);
+
+        if (index >= batchSize.load (std::memory_order_relaxed))
+            return;
+
+        currentTask.load (std::memory_order_relaxed) (currentContext.load (std::memory_order_relaxed), index);
+        numFinished.fetch_add (1, std::memory_order_acq_rel);
+    }
+}
+
+void WorkerPool::workerLoop()
+{
+    auto seenGeneration = generation.load (std::memory_order_acquire);
+    const auto idleSchedule = getCurrentSchedule();
+    auto workerSchedule = idleSchedule;
+
+    while (! shouldExit.load (std::memory_order_acquire))
+    {
+        //wait for a new batch: spin for a moment, then sleep until notified
+        const auto spinEnd = std::chrono::steady_clock::now() + idleSpinTime;
+
+        while (generation.load (std::memory_order_acquire) == seenGeneration && std::chrono::steady_clock::now() < spinEnd)
+            std::this_thread::yield();
+
+        if (generation.load (std::memory_order_acquire) == seenGeneration)
+        {
+            //a sleeping worker gives up the caller's priority, so an idle pool never holds a realtime slot
+            if (workerSchedule != idleSchedule && setCurrentSchedule (idleSchedule))
+                workerSchedule = idleSchedule;
+
+            //a post meant for a worker that then found the batch without sleeping is left over,
+            //and only costs a later sleep an extra look round the loop
+            numSleeping.fetch_add (1, std::memory_order_seq_cst);
+
+            if (generation.load (std::memory_order_seq_cst) == seenGeneration && ! shouldExit.load())
+                wakeUp->wait();
+
+            numSleeping.fetch_sub (1, std::memory_order_relaxed);
+        }
+
+        const auto latest = generation.load (std::memory_order_acquire);
+
+        //each batch is claimed from once, so the parked nextTask only moves per batch
+        if (latest != seenGeneration)
+        {
+            seenGeneration = latest;
+
+            //never below the caller, which spins until every claimed task is done
+            const auto schedule = callerSchedule.load (std::memory_order_relaxed);
+
+            if (schedule != noSchedule && schedule != workerSchedule)
+            {
+                if (! setCurrentSchedule (schedule))
+                {
+                    refusedSchedule.store (schedule, std::memory_order_relaxed);
+                    continue;
+                }
+
+                workerSchedule = schedule;
+            }
+
+            runClaimedTasks();
+        }
+    }
+}
+
+//==============================================================================
+int WorkerPool::getCurrentSchedule() noexcept
+{
+   #if defined (_WIN32)
+    //Windows priorities run from -15 to 31; offset so none collides with noSchedule
+    const auto priority = GetThreadPriority (GetCurrentThread());
+    return priority == THREAD_PRIORITY_ERROR_RETURN ? noSchedule : priority + 64;
+   #else
+    int policy = 0;
+    sched_param parameters {};
+
+    //takes the thread's lock in glibc, which is why run() only calls this once per caller
+    if (pthread_getschedparam (pthread_self(), &policy, &parameters) != 0)
+        return noSchedule;
+
+    return (policy << 8) | (parameters.sched_priority & 0xff);
+   #endif
+}
+
+bool WorkerPool::setCurrentSchedule (int schedule) noexcept
+{
+   #if defined (_WIN32)
+    return SetThreadPriority (GetCurrentThread(), schedule - 64) != 0;
+   #else
+    sched_param parameters {};
+    parameters.sched_priority = schedule & 0xff;
+    return pthread_setschedparam (pthread_self(), schedule >> 8, &parameters) == 0;
+   #endif
+}
+
+} // namespace jafftune
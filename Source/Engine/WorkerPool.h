@@ -0,0 +1,107 @@
+/*
+  ==============================================================================
+
+    WorkerPool.h
+    Small fixed pool of threads that help the audio thread with parallel work.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace jafftune
+{
+
+//==============================================================================
+/**
+    Runs a batch of independent tasks across the calling thread and a few
+    helper threads.
+
+    run() is safe to call from the audio thread: it never allocates and
+    never waits for a worker to wake up. The caller claims tasks itself
+    alongside any idle workers, so a batch always finishes even if no worker
+    gets scheduled; it only ever waits (spinning) for tasks a worker has
+    already started. Idle workers spin for tens of microseconds and then
+    sleep on a semaphore, which run() posts only when one of them is asleep.
+    That post is the only system call a batch can make, and it never blocks.
+
+    So that the wait can't turn into a priority inversion, a worker takes on
+    the scheduling policy and priority of the thread calling run() before it
+    claims any of that batch's tasks. Reading that priority takes the
+    thread's lock, so it is read on the first batch after start() or
+    resetCallerSchedule() and reused from then on. If the OS won't allow a
+    worker that priority, the worker sits the batch out, and run() keeps
+    later batches at that priority to itself. A worker goes back to its own
+    priority before it sleeps, so idle workers never hold a realtime slot.
+*/
+class WorkerPool
+{
+public:
+    //==============================================================================
+    /** A task: called once per index in [0, numTasks) with the batch's context. */
+    using Task = void (*) (void* context, int taskIndex);
+
+    WorkerPool();
+    ~WorkerPool();
+
+    /** Starts numWorkers helper threads (none if numWorkers <= 0). Not real-time safe. */
+    void start (int numWorkers);
+
+    /** Joins the helper threads. Not real-time safe. */
+    void stop();
+
+    int getNumWorkers() const noexcept      { return (int) threads.size(); }
+
+    /** Makes the next run() read its caller's priority again, for when the
+        thread calling run() may have changed (from prepareToPlay, say).
+    */
+    void resetCallerSchedule() noexcept     { callerSchedule.store (unknownSchedule, std::memory_order_relaxed); }
+
+    //==============================================================================
+    /** Calls task (context, i) for every i in [0, numTasks) and returns once all have finished. */
+    void run (Task task, void* context, int numTasks) noexcept;
+
+private:
+    //==============================================================================
+    void workerLoop();
+    void runClaimedTasks() noexcept;
+
+    //a task index no batch reaches, parked in nextTask between batches
+    static constexpr int noTasks = 1 << 30;
+
+    //a thread's scheduling policy and priority, packed into one value so they're published together
+    static constexpr int noSchedule = -1;
+    static constexpr int unknownSchedule = -2;
+    static int getCurrentSchedule() noexcept;
+    static bool setCurrentSchedule (int schedule) noexcept;
+
+    //a semaphore workers sleep on, posted without a lock: POSIX, dispatch or Win32
+    struct Semaphore;
+
+    std::vector<std::thread> threads;
+    std::unique_ptr<Semaphore> wakeUp;
+    std::atomic<int> numSleeping { 0 };
+    std::atomic<bool> shouldExit { false };
+
+    //the current batch; task, context and size are written before nextTask is released
+    std::atomic<Task> currentTask { nullptr };
+    std::atomic<void*> currentContext { nullptr };
+    std::atomic<int> batchSize { 0 };
+    std::atomic<int> nextTask { noTasks };
+    std::atomic<int> numFinished { 0 };
+    std::atomic<unsigned int> generation { 0 };
+
+    //the caller's schedule, read on its first batch, and the last one a worker was refused
+    std::atomic<int> callerSchedule { unknownSchedule };
+    std::atomic<int> refusedSchedule { noSchedule };
+
+    WorkerPool (const WorkerPool&) = delete;
+    WorkerPool& operator= (const WorkerPool&) = delete;
+};
+
+} // namespace jafftune
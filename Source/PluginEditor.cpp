@@ -9,17 +9,40 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+//==============================================================================
+namespace
+{
+    const juce::Colour displayBackground { 0xff15181c };
+    const juce::Colour gridColour { 0xff353a42 };
+    const juce::Colour meterColour { 0xff4fc27a };
+    const juce::Colour meterHotColour { 0xffe0a030 };
+    const juce::Colour windowColour { 0xff6a7280 };
+    const juce::Colour tapColours[] = { juce::Colour (0xff5aa8ff), juce::Colour (0xffff7a5a) };
+    
+    const char* const meterNames[] = { "In L", "In R", "Out L", "Out R" };
+    const char* const noteNames[] = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
+}
+
 //==============================================================================
 JafftuneAudioProcessorEditor::JafftuneAudioProcessorEditor (JafftuneAudioProcessor& p)
-    : AudioProcessorEditor (&p), audioProcessor (p)
+    : AudioProcessorEditor (&p), audioProcessor (p), parameterEditor (p)
 {
+    addAndMakeVisible (parameterEditor);
+    setOpaque (true);
+    
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
-    setSize (400, 300);
+    setSize (parameterEditor.getWidth() + displayWidth,
+             juce::jmax (320, parameterEditor.getHeight()) + statisticsHeight);
+    
+    audioProcessor.setMeteringActive (true);
+    startTimerHz (displayRateHz);
 }
 
 JafftuneAudioProcessorEditor::~JafftuneAudioProcessorEditor()
 {
+    stopTimer();
+    audioProcessor.setMeteringActive (false);
 }
 
 //==============================================================================
@@ -27,14 +50,288 @@ void JafftuneAudioProcessorEditor::paint (juce::Graphics& g)
 {
     // (Our component is opaque, so we must completely fill the background with a solid colour)
     g.fillAll (getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId));
+    
+    //most repaints only cover one region, so the others are skipped outright
+    if (g.clipRegionIntersects (meterArea))
+        paintMeters (g);
+    
+    if (g.clipRegionIntersects (grainArea))
+        paintGrains (g);
+    
+    if (g.clipRegionIntersects (pitchArea))
+        paintPitch (g);
+    
+    if (g.clipRegionIntersects (statisticsArea))
+        paintStatistics (g);
+}
+
+void JafftuneAudioProcessorEditor::resized()
+{
+    auto area = getLocalBounds();
+    
+    statisticsArea = area.removeFromBottom (statisticsHeight);
+    
+    auto display = area.removeFromRight (displayWidth).reduced (8);
+    meterArea = display.removeFromTop (display.getHeight() / 2);
+    pitchArea = display.removeFromBottom (40);
+    grainArea = display.withTrimmedTop (8);
+    
+    parameterEditor.setBounds (area);
+    
+    renderMeterBackground();
+    renderGrainBackground();
+}
+
+//==============================================================================
+juce::Rectangle<int> JafftuneAudioProcessorEditor::getMeterBar (int meter) const
+{
+    //four bars between a dB scale on the left and names along the bottom
+    auto bars = meterArea.withTrimmedLeft (28).withTrimmedBottom (16);
+    const auto barWidth = bars.getWidth() / numMeters;
+    
+    return bars.withX (bars.getX() + meter * barWidth).withWidth (barWidth).reduced (6, 0);
+}
+
+int JafftuneAudioProcessorEditor::getMeterHeight (float level) const
+{
+    const auto db = juce::Decibels::gainToDecibels (level, meterFloorDb);
+    const auto proportion = juce::jlimit (0.0f, 1.0f, (db - meterFloorDb) / -meterFloorDb);
+    
+    return juce::roundToInt (proportion * (float) getMeterBar (0).getHeight());
+}
+
+void JafftuneAudioProcessorEditor::renderMeterBackground()
+{
+    if (meterArea.isEmpty())
+        return;
+    
+    meterBackground = juce::Image (juce::Image::RGB, meterArea.getWidth(), meterArea.getHeight(), true);
+    juce::Graphics g (meterBackground);
+    g.setOrigin (-meterArea.getPosition());
+    
+    g.fillAll (displayBackground);
+    g.setFont (11.0f);
+    
+    const auto bar = getMeterBar (0);
+    
+    for (auto db = 0.0f; db >= meterFloorDb; db -= 12.0f)
+    {
+        const auto y = bar.getBottom() - getMeterHeight (juce::Decibels::decibelsToGain (db));
+        
+        g.setColour (gridColour);
+        g.drawHorizontalLine (y, (float) bar.getX(), (float) meterArea.getRight());
+        g.setColour (juce::Colours::grey);
+        g.drawText (juce::String ((int) db), meterArea.getX(), y - 6, 24, 12, juce::Justification::centredRight);
+    }
+    
+    for (int meter = 0; meter < numMeters; ++meter)
+    {
+        const auto meterBar = getMeterBar (meter);
+        
+        g.setColour (gridColour);
+        g.drawRect (meterBar.expanded (1, 0));
+        g.setColour (juce::Colours::grey);
+        g.drawText (meterNames[meter], meterBar.getX() - 6, meterBar.getBottom() + 2, meterBar.getWidth() + 12, 14,
+                    juce::Justification::centred);
+    }
+}
+
+void JafftuneAudioProcessorEditor::renderGrainBackground()
+{
+    if (grainArea.isEmpty())
+        return;
+    
+    //a tap's gain against its position across the delay window, sin (pi * position); both taps ride it half a window apart
+    grainBackground = juce::Image (juce::Image::RGB, grainArea.getWidth(), grainArea.getHeight(), true);
+    juce::Graphics g (grainBackground);
+    
+    const auto width = grainArea.getWidth();
+    juce::Path window;
+    
+    for (int x = 0; x <= width; ++x)
+    {
+        const auto y = (float) (getGrainY ((float) x / (float) width) - grainArea.getY());
+        
+        if (x == 0)
+            window.startNewSubPath ((float) x, y);
+        else
+            window.lineTo ((float) x, y);
+    }
+    
+    g.fillAll (displayBackground);
+    g.setColour (gridColour);
+    g.drawHorizontalLine (grainArea.getHeight() - 1, 0.0f, (float) width);
+    g.setColour (windowColour);
+    g.strokePath (window, juce::PathStrokeType (1.5f));
+}
+
+float JafftuneAudioProcessorEditor::getGrainY (float position) const
+{
+    const auto height = (float) grainArea.getHeight() - 4.0f;
+    
+    return (float) grainArea.getY() + 2.0f + height * (1.0f - std::sin (juce::MathConstants<float>::pi * position));
+}
+
+//==============================================================================
+void JafftuneAudioProcessorEditor::paintMeters (juce::Graphics& g)
+{
+    g.drawImageAt (meterBackground, meterArea.getX(), meterArea.getY());
+    
+    for (int meter = 0; meter < numMeters; ++meter)
+    {
+        const auto bar = getMeterBar (meter);
+        const auto height = paintedMeterHeights[meter];
+        
+        g.setColour (levels[meter] >= 1.0f ? meterHotColour : meterColour);
+        g.fillRect (bar.withTop (bar.getBottom() - height));
+    }
+}
+
+void JafftuneAudioProcessorEditor::paintGrains (juce::Graphics& g)
+{
+    g.drawImageAt (grainBackground, grainArea.getX(), grainArea.getY());
+    
+    if (! paintedGrains)
+    {
+        g.setColour (juce::Colours::grey);
+        g.setFont (12.0f);
+        g.drawText ("Delay taps idle", grainArea, juce::Justification::centred);
+        return;
+    }
+    
+    //each tap as a dot on the window, at its current position and gain
+    for (int tap = 0; tap < 2; ++tap)
+    {
+        const auto x = grainArea.getX() + paintedTapPositions[tap];
+        const auto y = getGrainY (std::fmod (phasor + 0.5f * (float) tap, 1.0f));
+        
+        g.setColour (tapColours[tap]);
+        g.drawVerticalLine (x, y, (float) grainArea.getBottom());
+        g.fillEllipse ((float) x - 4.0f, y - 4.0f, 8.0f, 8.0f);
+    }
+}
 
+void JafftuneAudioProcessorEditor::paintPitch (juce::Graphics& g)
+{
     g.setColour (juce::Colours::white);
-    g.setFont (15.0f);
-    g.drawFittedText ("Hello World!", getLocalBounds(), juce::Justification::centred, 1);
+    g.setFont (14.0f);
+    g.drawFittedText (pitchText, pitchArea, juce::Justification::centred, 2);
 }
 
-void JafftuneAudioProcessorEditor::resized()
+void JafftuneAudioProcessorEditor::paintStatistics (juce::Graphics& g)
+{
+    const auto latency = audioProcessor.getLatencySamples();
+    const auto sampleRate = audioProcessor.getSampleRate();
+    const auto latencyMs = sampleRate > 0.0 ? 1000.0 * latency / sampleRate : 0.0;
+    
+    const juce::String timing = "Block time   min " + juce::String (statistics.minMicroseconds, 1)
+                              + " us   mean " + juce::String (statistics.meanMicroseconds, 1)
+                              + " us   p99 " + juce::String (statistics.p99Microseconds, 1)
+                              + " us   max " + juce::String (statistics.maxMicroseconds, 1) + " us";
+    
+    const juce::String load = "Deadline used   mean " + juce::String (100.0 * statistics.meanLoad, 1)
+                            + "%   p99 " + juce::String (100.0 * statistics.p99Load, 1)
+                            + "%   max " + juce::String (100.0 * statistics.maxLoad, 1)
+                            + "%   overruns " + juce::String ((juce::int64) statistics.overruns)
+                            + " of " + juce::String ((juce::int64) statistics.totalBlocks);
+    
+    const juce::String counters = "Latency " + juce::String (latency) + " samples (" + juce::String (latencyMs, 1)
+                                + " ms)   mode switches " + juce::String ((int) statistics.modeSwitches)
+                                + "   dropped timings " + juce::String ((int) statistics.droppedBlocks);
+    
+    //the deadline line warns once the worst blocks get close to an xrun
+    const auto risk = juce::jmax (statistics.p99Load, statistics.maxLoad);
+    const auto loadColour = risk >= 0.8 ? juce::Colours::red
+                          : risk >= 0.5 ? juce::Colours::orange
+                                        : juce::Colours::white;
+    
+    auto area = statisticsArea.reduced (8, 4);
+    const auto lineHeight = area.getHeight() / 3;
+    
+    g.setFont (13.0f);
+    g.setColour (juce::Colours::white);
+    g.drawFittedText (timing, area.removeFromTop (lineHeight), juce::Justification::centredLeft, 1);
+    g.setColour (loadColour);
+    g.drawFittedText (load, area.removeFromTop (lineHeight), juce::Justification::centredLeft, 1);
+    g.setColour (juce::Colours::white);
+    g.drawFittedText (counters, area, juce::Justification::centredLeft, 1);
+}
+
+//==============================================================================
+void JafftuneAudioProcessorEditor::timerCallback()
 {
-    // This is generally where you'll want to lay out the positions of any
-    // subcomponents in your editor..
+    //the newest snapshot gives the phasor and pitch; peaks are the loudest since the last tick
+    JafftuneAudioProcessor::MeterSnapshot snapshot;
+    float peaks[numMeters] = {};
+    const auto decay = juce::Decibels::decibelsToGain (-meterFallDbPerSecond / (float) displayRateHz);
+    bool received = false;
+    
+    while (audioProcessor.popMeterSnapshot (snapshot))
+    {
+        for (int ch = 0; ch < 2; ++ch)
+        {
+            peaks[ch] = juce::jmax (peaks[ch], snapshot.inputPeak[ch]);
+            peaks[ch + 2] = juce::jmax (peaks[ch + 2], snapshot.outputPeak[ch]);
+        }
+        
+        received = true;
+    }
+    
+    for (int meter = 0; meter < numMeters; ++meter)
+    {
+        levels[meter] = juce::jmax (peaks[meter], levels[meter] * decay);
+        
+        const auto height = getMeterHeight (levels[meter]);
+        
+        if (height != paintedMeterHeights[meter])
+        {
+            //only the part of the bar between the old and new tops changes
+            const auto bar = getMeterBar (meter);
+            const auto top = bar.getBottom() - juce::jmax (height, paintedMeterHeights[meter]);
+            const auto bottom = bar.getBottom() - juce::jmin (height, paintedMeterHeights[meter]);
+            
+            paintedMeterHeights[meter] = height;
+            repaint (bar.withTop (top).withBottom (bottom));
+        }
+    }
+    
+    if (received)
+    {
+        phasor = snapshot.phasor;
+        
+        const int tapPositions[] = { juce::roundToInt (phasor * (float) grainArea.getWidth()),
+                                     juce::roundToInt (std::fmod (phasor + 0.5f, 1.0f) * (float) grainArea.getWidth()) };
+        
+        if (snapshot.showsGrains != paintedGrains
+             || (snapshot.showsGrains && (tapPositions[0] != paintedTapPositions[0] || tapPositions[1] != paintedTapPositions[1])))
+        {
+            paintedGrains = snapshot.showsGrains;
+            paintedTapPositions[0] = tapPositions[0];
+            paintedTapPositions[1] = tapPositions[1];
+            repaint (grainArea);
+        }
+        
+        juce::String text;
+        
+        if (snapshot.detectedFrequency > 0.0f)
+        {
+            const auto note = juce::roundToInt (12.0f * std::log2 (snapshot.detectedFrequency / 440.0f)) + 69;
+            
+            text = juce::String (snapshot.detectedFrequency, 1) + " Hz  " + noteNames[((note % 12) + 12) % 12]
+                 + juce::String (note / 12 - 1) + "\ncorrection " + juce::String (snapshot.correctionSemitones, 2) + " st";
+        }
+        
+        if (text != pitchText)
+        {
+            pitchText = text;
+            repaint (pitchArea);
+        }
+    }
+    
+    if (--ticksUntilStatistics <= 0)
+    {
+        ticksUntilStatistics = statisticsInterval;
+        statistics = audioProcessor.getPerformanceMonitor().collect();
+        repaint (statisticsArea);
+    }
 }
@@ -13,8 +13,18 @@
 
 //==============================================================================
 /**
+    The generic parameter editor with a display beside it: input and output
+    peak meters, the phasor sweeping the two grain windows, the detected pitch
+    in Pitch Correction mode, and underneath, how long processBlock is taking
+    against the block deadline.
+
+    The display is fed by snapshots the audio thread pushes through a
+    wait-free ring. A timer capped at displayRateHz drains them and only
+    repaints the parts whose pixels actually change, drawing over background
+    images rendered once per resize, so many open editors stay cheap.
 */
-class JafftuneAudioProcessorEditor  : public juce::AudioProcessorEditor
+class JafftuneAudioProcessorEditor  : public juce::AudioProcessorEditor,
+                                      private juce::Timer
 {
 public:
     JafftuneAudioProcessorEditor (JafftuneAudioProcessor&);
@@ -25,9 +35,50 @@ public:
     void resized() override;
 
 private:
+    //drains the meter snapshots and repaints what moved; the performance statistics refresh less often
+    void timerCallback() override;
+    
+    void renderMeterBackground();
+    void renderGrainBackground();
+    juce::Rectangle<int> getMeterBar (int meter) const;
+    int getMeterHeight (float level) const;
+    float getGrainY (float position) const;
+    
+    void paintMeters (juce::Graphics&);
+    void paintGrains (juce::Graphics&);
+    void paintPitch (juce::Graphics&);
+    void paintStatistics (juce::Graphics&);
+    
+    static constexpr int displayWidth = 240;
+    static constexpr int statisticsHeight = 72;
+    static constexpr int displayRateHz = 30;
+    static constexpr int statisticsInterval = 3;    // timer ticks per statistics refresh
+    static constexpr int numMeters = 4;             // in L, in R, out L, out R
+    static constexpr float meterFloorDb = -60.0f;
+    static constexpr float meterFallDbPerSecond = 20.0f;
+    
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     JafftuneAudioProcessor& audioProcessor;
+    
+    juce::GenericAudioProcessorEditor parameterEditor;
+    
+    //layout, and the static parts of the display rendered once per resize
+    juce::Rectangle<int> meterArea, grainArea, pitchArea, statisticsArea;
+    juce::Image meterBackground, grainBackground;
+    
+    //display state, with decaying peak levels
+    float levels[numMeters] = {};
+    float phasor = 0.0f;
+    juce::String pitchText;
+    
+    //what was last painted, so unchanged regions aren't repainted
+    int paintedMeterHeights[numMeters] = {};
+    int paintedTapPositions[2] = { -1, -1 };
+    bool paintedGrains = false;
+    
+    jafftune::PerformanceStats statistics;
+    int ticksUntilStatistics = 0;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (JafftuneAudioProcessorEditor)
 };
@@ -7,8 +7,6 @@
     
     YET TO IMPLEMENT:
     -Allow user to type values into sliders
-    -Independent Pitch Control per Channel in Stereo Mode
-    -Resolve delayWindow to a function of pitchRatio to keep phasorFreq < 5
     -Build and codesign Windows Installer
     -Add CMake support
  
@@ -18,6 +16,11 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+//saves the state as XML rather than binary, for debugging; either format loads
+#ifndef JAFFTUNE_XML_STATE
+ #define JAFFTUNE_XML_STATE 0
+#endif
+
 //==============================================================================
 JafftuneAudioProcessor::JafftuneAudioProcessor()
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -31,10 +34,45 @@ JafftuneAudioProcessor::JafftuneAudioProcessor()
                        )
 #endif
 {
+    //cache the parameter atomics so processBlock never looks them up by name
+    pitchRatioParameter = treeState.getRawParameterValue ("Pitch Ratio");
+    blendParameter = treeState.getRawParameterValue ("Blend");
+    volumeParameter = treeState.getRawParameterValue ("Volume");
+    operationModeParameter = treeState.getRawParameterValue ("Operation Mode");
+    interpolationParameter = treeState.getRawParameterValue ("Interpolation");
+    harmonyVoicesParameter = treeState.getRawParameterValue ("Harmony Voices");
+    
+    for (int v = 0; v < jafftune::PitchShiftEngine<float>::maxHarmonyVoices; ++v)
+    {
+        const juce::String voice = "Voice " + juce::String (v + 1);
+        voiceRatioParameters[v] = treeState.getRawParameterValue (voice + " Ratio");
+        voiceGainParameters[v] = treeState.getRawParameterValue (voice + " Gain");
+        voicePanParameters[v] = treeState.getRawParameterValue (voice + " Pan");
+    }
+    
+    correctionKeyParameter = treeState.getRawParameterValue ("Correction Key");
+    correctionScaleParameter = treeState.getRawParameterValue ("Correction Scale");
+    retuneSpeedParameter = treeState.getRawParameterValue ("Retune Speed");
+    midiControlParameter = treeState.getRawParameterValue ("MIDI Control");
+    referenceNoteParameter = treeState.getRawParameterValue ("Reference Note");
+    pitchBendRangeParameter = treeState.getRawParameterValue ("Pitch Bend Range");
+    adaptiveWindowParameter = treeState.getRawParameterValue ("Adaptive Window");
+    latencyCeilingParameter = treeState.getRawParameterValue ("Latency Ceiling");
+    channelModeParameter = treeState.getRawParameterValue ("Channel Mode");
+    oversamplingParameter = treeState.getRawParameterValue ("Oversampling");
+    oversamplingFilterParameter = treeState.getRawParameterValue ("Oversampling Filter");
+    algorithmParameter = treeState.getRawParameterValue ("Algorithm");
+    vocoderQualityParameter = treeState.getRawParameterValue ("Vocoder Quality");
+    preserveFormantsParameter = treeState.getRawParameterValue ("Preserve Formants");
+    formantRatioParameter = treeState.getRawParameterValue ("Formant Ratio");
+    
+    for (int ch = 0; ch < maxChannels; ++ch)
+        channelRatioParameters[ch] = treeState.getRawParameterValue ("Channel " + juce::String (ch + 1) + " Ratio");
 }
 
 JafftuneAudioProcessor::~JafftuneAudioProcessor()
 {
+    stopTimer();
 }
 
 //==============================================================================
@@ -72,7 +110,7 @@ bool JafftuneAudioProcessor::isMidiEffect() const
 
 double JafftuneAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    return tailLengthSeconds.load (std::memory_order_relaxed);
 }
 
 int JafftuneAudioProcessor::getNumPrograms()
@@ -102,29 +140,217 @@ void JafftuneAudioProcessor::changeProgramName (int index, const juce::String& n
 //==============================================================================
 void JafftuneAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    //initialzie spec
-    juce::dsp::ProcessSpec spec;
-    spec.maximumBlockSize = samplesPerBlock;
-    spec.sampleRate = sampleRate;
-    spec.numChannels = getTotalNumOutputChannels();
+    //all engine memory is allocated here, sized from the actual sample rate
+    const juce::ScopedLock lock (preparationLock);
+    const auto numChannels = getTotalNumOutputChannels();
+    const auto operationMode = static_cast<int> (operationModeParameter->load());
+    const bool doublePrecision = isUsingDoublePrecision();
+    
+    performanceMonitor.prepare (sampleRate);
+    
+    //hosts prepare again around session and preset loads; with nothing that sizes a buffer changed,
+    //the engines and oversampler keep their memory and are only cleared
+    const auto newStages = static_cast<int> (oversamplingParameter->load());
+    const auto newFilter = static_cast<int> (oversamplingFilterParameter->load());
+    const bool reuseBuffers = sampleRate == preparedSampleRate
+                           && samplesPerBlock == preparedBlockSize
+                           && doublePrecision == preparedDoublePrecision
+                           && numChannels == oversampledChannels
+                           && newStages == oversamplingStages
+                           && newFilter == oversamplingFilter;
+    
+    preparedSampleRate = sampleRate;
+    preparedBlockSize = samplesPerBlock;
+    preparedDoublePrecision = doublePrecision;
+    
+    //with oversampling on, the engines see the oversampled rate and block size
+    oversamplingStages = newStages;
+    oversamplingFilter = newFilter;
+    oversampledChannels = numChannels;
+    
+    //the host picks the precision before preparing, so only that set of engines is allocated
+    if (doublePrecision)
+        prepareEngines (doubleEngines, sampleRate, samplesPerBlock, reuseBuffers);
+    else
+        prepareEngines (floatEngines, sampleRate, samplesPerBlock, reuseBuffers);
+    
+    //helper threads share the channel engines out once there are enough of them
+    const auto numWorkers = numChannels >= parallelChannelThreshold
+                          ? juce::jlimit (0, maxWorkerThreads, juce::jmin (juce::SystemStats::getNumCpus() - 1, numChannels - 1))
+                          : 0;
+    
+    if (numWorkers != workerPool.getNumWorkers())
+        workerPool.start (numWorkers);
+    
+    //the host may hand processBlock to another thread after a prepare, so its priority is read again
+    workerPool.resetCallerSchedule();
+    
+    numHeldNotes = 0;
+    midiNote = -1;
+    pitchBend = 0.0f;
+    
+    if (doublePrecision)
+    {
+        setLatencySamples (getTotalLatency (operationMode, doubleEngines));
+        tailLengthSeconds.store (getTailLength (operationMode, doubleEngines), std::memory_order_relaxed);
+    }
+    else
+    {
+        setLatencySamples (getTotalLatency (operationMode, floatEngines));
+        tailLengthSeconds.store (getTailLength (operationMode, floatEngines), std::memory_order_relaxed);
+    }
     
-    phasor.prepare (spec); //pass spec to phasor
-    phasor.setFrequency( 1000.0f * ((1.0f - pitchRatio) / delayWindow) ); //set initial phasor frequency
-    reversePhasor.prepare (spec); //pass spec to phasor
-    reversePhasor.setFrequency( 1000.0f * ((1.0f - pitchRatio) / delayWindow) ); //set initial reverse phasor frequency
+    pendingLatency.store (getLatencySamples(), std::memory_order_relaxed);
+    
+    //may be called off the message thread, which startTimer allows
+    startTimerHz (messageThreadPollsPerSecond);
+}
 
-    phasorGain.setGainLinear( 1.0f );
-    reversePhasorGain.setGainLinear ( 1.0f );
+template <typename SampleType>
+void JafftuneAudioProcessor::prepareEngines (EngineSet<SampleType>& engines, double sampleRate, int samplesPerBlock, bool reuseBuffers)
+{
+    const auto numChannels = oversampledChannels;
+    
+    if (reuseBuffers)
+    {
+        if (engines.oversampler != nullptr)
+            engines.oversampler->reset();
+    }
+    else if (oversamplingStages > 0)
+    {
+        using Oversampling = juce::dsp::Oversampling<SampleType>;
+        const auto filterType = oversamplingFilter == 0 ? Oversampling::filterHalfBandPolyphaseIIR
+                                                        : Oversampling::filterHalfBandFIREquiripple;
+        
+        //integer latency, so what the host is told lines up exactly
+        engines.oversampler = std::make_unique<Oversampling> (static_cast<size_t> (numChannels),
+                                                              static_cast<size_t> (oversamplingStages),
+                                                              filterType, true, true);
+        engines.oversampler->initProcessing (static_cast<size_t> (samplesPerBlock));
+    }
+    else
+    {
+        engines.oversampler.reset();
+    }
     
-    mDelayLineOne.reset();
-    mDelayLineOne.setMaximumDelayInSamples (getSampleRate());
-    mDelayLineOne.prepare (spec);
+    //only the group the settings call for is prepared; a switch in progress is dropped along with the standby
+    auto& active = engines.getActive();
+    const auto config = getWantedConfig (active.config);
+    
+    prepareGroup (active, config, reuseBuffers && config == active.config && ! active.engines.empty());
+    engines.getStandby() = {};
+    engines.standbyReady.store (false, std::memory_order_relaxed);
+    engines.handingOver = false;
+}
+
+template <typename SampleType>
+void JafftuneAudioProcessor::prepareGroup (EngineGroup<SampleType>& group, const EngineConfig& config, bool reuseBuffers)
+{
+    const auto numChannels = oversampledChannels;
+    const auto operationMode = static_cast<int> (operationModeParameter->load());
+    const auto pitchRatio = pitchRatioParameter->load();
+    const auto factor = 1 << oversamplingStages;
+    
+    //the stereo engine, or a mono engine per channel
+    if (! reuseBuffers)
+    {
+        group.engines.clear();
+        group.engines.resize (config.perChannel ? static_cast<size_t> (numChannels) : 1);
+        group.config = config;
+    }
+    
+    for (size_t i = 0; i < group.engines.size(); ++i)
+    {
+        auto& target = group.engines[i];
+        
+        target.setMaximumDelayWindow (config.maximumWindow);
+        target.setPhaseVocoderEnabled (config.withVocoder);
+        target.setPitchRatio (config.perChannel ? pitchRatio * getChannelRatio (static_cast<int> (i)) : pitchRatio);
+        configureEngine (target, getDelayWindowFor (operationMode, pitchRatio), operationMode);
+        
+        //values set before prepare (or a reset) apply immediately; later changes are ramped per sample
+        if (reuseBuffers)
+            target.reset();
+        else
+            target.prepare (preparedSampleRate * factor, preparedBlockSize * factor, config.perChannel ? 1 : juce::jmin (2, numChannels));
+    }
+}
+
+JafftuneAudioProcessor::EngineConfig JafftuneAudioProcessor::getWantedConfig (const EngineConfig& current) const
+{
+    EngineConfig config;
+    config.perChannel = usesChannelEngines();
+    config.withVocoder = algorithmParameter->load() >= 0.5f || preserveFormantsParameter->load() >= 0.5f;
+    
+    //the history holds the fixed window, or with Adaptive Window on, the longest the latency ceiling allows
+    //(the harmonizer still uses the fixed one); it grows to at least double and only shrinks once it is four
+    //times too long, so dragging the ceiling prepares new engines a couple of times rather than at every step
+    const auto needed = adaptiveWindowParameter->load() >= 0.5f ? juce::jmax (delayWindow, 2.0f * latencyCeilingParameter->load())
+                                                                : delayWindow;
+    const auto kept = current.maximumWindow;
+    
+    if (needed <= kept && needed * 4.0f > kept)
+        config.maximumWindow = kept;
+    else if (needed > kept && kept > 0.0f)
+        config.maximumWindow = juce::jmin (2.0f * maximumLatencyCeiling, juce::jmax (needed, 2.0f * kept));
+    else
+        config.maximumWindow = needed;
+    
+    return config;
+}
+
+template <typename SampleType>
+void JafftuneAudioProcessor::prepareStandby (EngineSet<SampleType>& engines)
+{
+    const juce::ScopedLock lock (preparationLock);
+    
+    //once it's ready, the standby group is the audio thread's until it has taken over
+    if (engines.standbyReady.load (std::memory_order_acquire))
+        return;
+    
+    const auto config = getWantedConfig (engines.getActive().config);
+    auto& standby = engines.getStandby();
+    
+    //the group handed over from gives its memory back once the active one suits
+    if (config == engines.getActive().config)
+    {
+        if (! standby.engines.empty())
+            standby = {};
+        
+        return;
+    }
+    
+    prepareGroup (standby, config, false);
+    engines.standbyReady.store (true, std::memory_order_release);
+}
+
+template <typename SampleType>
+void JafftuneAudioProcessor::handOver (EngineSet<SampleType>& engines, float pitchRatio, int operationMode)
+{
+    //the incoming group starts from the bypass the outgoing one faded out to, then fades into the mode
+    //itself (first warming its history, if it reads the delay taps), so the switch never jumps
+    auto& incoming = engines.getStandby();
+    const auto window = getDelayWindowFor (operationMode, pitchRatio);
+    
+    setPitchRatios (incoming, pitchRatio, true);
+    
+    for (auto& target : incoming.engines)
+    {
+        configureEngine (target, window, operationMode);
+        target.resetToBypass (engines.handoverMode);
+    }
+    
+    engines.active = 1 - engines.active;
+    engines.handingOver = false;
+    engines.standbyReady.store (false, std::memory_order_release);
 }
 
 void JafftuneAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    stopTimer();
+    workerPool.stop();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -134,12 +360,13 @@ bool JafftuneAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts)
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
+    // Any layout from mono up to 7.1.4 (12 channels); beyond stereo every
+    // channel gets its own engine.
     // Some plugin hosts, such as certain GarageBand versions, will only
     // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    const auto numChannels = layouts.getMainOutputChannelSet().size();
+    
+    if (layouts.getMainOutputChannelSet().isDisabled() || numChannels > maxChannels)
         return false;
 
 
@@ -155,157 +382,474 @@ bool JafftuneAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts)
 #endif
 
 void JafftuneAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    process (buffer, midiMessages, floatEngines);
+}
+
+void JafftuneAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    process (buffer, midiMessages, doubleEngines);
+}
+
+bool JafftuneAudioProcessor::supportsDoublePrecisionProcessing() const
+{
+    return true;
+}
+
+template <typename SampleType>
+void JafftuneAudioProcessor::process (juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiMessages,
+                                      EngineSet<SampleType>& engines)
 {
     juce::ScopedNoDenormals noDenormals;
+    jafftune::ScopedNoAllocation noAllocation; //asserts on any heap allocation in Debug builds
+    jafftune::PerformanceMonitor::ScopedBlockTimer blockTimer (performanceMonitor, buffer.getNumSamples());
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
     
-    //set phasor~ frequency based on pitchRatio
-    float pitchRatio = treeState.getRawParameterValue ("Pitch Ratio")->load();
-    phasor.setFrequency ( abs(1000.0f * ((1.0f - pitchRatio) / delayWindow)) );
-    reversePhasor.setFrequency ( abs(1000.0f * ((1.0f - pitchRatio) / delayWindow)) );
-
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
     
-    //Operation mode (0 = Mono Bypass, 1 = Stereo Bypass, 2 = Mono Operation, 3 = Stereo (Wet L, Wet R), 4 = Stereo (Dry L, Wet R)
-    float operationMode = treeState.getRawParameterValue ("Operation Mode")->load();;
+    //input levels for the editor, if one is open
+    const bool metering = meteringActive.load (std::memory_order_relaxed);
+    
+    if (metering)
+        accumulatePeaks (buffer, pendingSnapshot.inputPeak);
+    
+    //set phasor~ frequency based on pitchRatio, or on the held MIDI note
+    const bool midiControl = midiControlParameter->load() >= 0.5f;
+    const auto pitchRatio = midiControl ? getMidiPitchRatio() : pitchRatioParameter->load();
+    
+    //Operation mode (0 = Mono Bypass, 1 = Stereo Bypass, 2 = Mono Operation, 3 = Stereo (Wet L, Wet R), 4 = Stereo (Dry L, Wet R), 5 = Harmonizer, 6 = Pitch Correction
+    auto operationMode = static_cast<int> (operationModeParameter->load());
+    
+    if (operationMode != lastOperationMode)
+    {
+        if (lastOperationMode >= 0)
+            performanceMonitor.noteModeSwitch();
+        
+        lastOperationMode = operationMode;
+    }
+    
+    //Channel engines: one per channel beyond stereo, or when each channel has its own ratio. A group the
+    //message thread has prepared for new channel, vocoder or window settings takes over once the running one
+    //has faded out to the bypass that leaves the channels it doesn't shift as they were
+    auto mode = static_cast<jafftune::OperationMode> (operationMode);
+    
+    if (! engines.handingOver && engines.standbyReady.load (std::memory_order_acquire))
+    {
+        engines.handingOver = true;
+        engines.handoverMode = mode == jafftune::OperationMode::monoBypass || mode == jafftune::OperationMode::mono
+                             ? jafftune::OperationMode::monoBypass
+                             : jafftune::OperationMode::stereoBypass;
+    }
+    
+    if (engines.handingOver)
+    {
+        //per channel, mono bypass only runs the first channel's engine
+        const auto& outgoing = engines.getActive();
+        const auto numRunning = outgoing.config.perChannel && engines.handoverMode == jafftune::OperationMode::stereoBypass
+                              ? outgoing.engines.size() : 1;
+        
+        if (std::all_of (outgoing.engines.begin(), outgoing.engines.begin() + static_cast<std::ptrdiff_t> (numRunning),
+                         [] (const auto& engine) { return engine.isBypassed(); }))
+            handOver (engines, pitchRatio, operationMode);
+        else
+            mode = engines.handoverMode;
+    }
+    
+    auto& group = engines.getActive();
+    setPitchRatios (group, pitchRatio);
+    
+    //Delay window, re-sized from the ratio in Adaptive Window mode; every channel shares it,
+    //so they stay aligned
+    const auto window = getDelayWindowFor (operationMode, pitchRatio);
+    
+    for (auto& target : group.engines)
+        configureEngine (target, window, operationMode);
+    
+    const auto numSamples = buffer.getNumSamples();
+    
+    //held notes and the bend are tracked even with MIDI Control off, so turning it on mid-note lands on that note;
+    //with it on, the block is split at each event that moves the ratio, so the new ratio starts on its exact sample
+    int position = 0;
+    
+    for (const auto metadata : midiMessages)
+    {
+        const auto message = metadata.getMessage();
+        
+        if (! handleMidiMessage (message) || ! midiControl)
+            continue;
+        
+        const auto eventPosition = juce::jlimit (position, numSamples, metadata.samplePosition);
+        processEngine (engines, buffer, position, eventPosition - position, mode);
+        position = eventPosition;
+        
+        const auto eventRatio = getMidiPitchRatio();
+        //a note lands on its pitch at once; the bend keeps the knob's glide
+        setPitchRatios (group, eventRatio, ! message.isPitchWheel());
+        setDelayWindows (group, getDelayWindowFor (operationMode, eventRatio));
+    }
+    
+    processEngine (engines, buffer, position, numSamples - position, mode);
+    
+    //worked out once the events are in, so it follows the window the last note chose; the host is
+    //told from the message thread, since its latency callbacks may allocate or lock
+    pendingLatency.store (getTotalLatency (operationMode, engines), std::memory_order_relaxed);
+    
+    tailLengthSeconds.store (getTailLength (operationMode, engines), std::memory_order_relaxed);
+    
+    if (metering)
+        publishMeters (buffer, engines, operationMode);
+}
+
+template <typename SampleType>
+void JafftuneAudioProcessor::accumulatePeaks (const juce::AudioBuffer<SampleType>& buffer, float* peaks)
+{
+    for (int ch = 0; ch < juce::jmin (2, buffer.getNumChannels()); ++ch)
+        peaks[ch] = juce::jmax (peaks[ch], static_cast<float> (buffer.getMagnitude (ch, 0, buffer.getNumSamples())));
+}
+
+template <typename SampleType>
+void JafftuneAudioProcessor::publishMeters (const juce::AudioBuffer<SampleType>& buffer, const EngineSet<SampleType>& engines,
+                                            int operationMode)
+{
+    accumulatePeaks (buffer, pendingSnapshot.outputPeak);
+    samplesUntilSnapshot -= buffer.getNumSamples();
+    
+    if (samplesUntilSnapshot > 0)
+        return;
+    
+    samplesUntilSnapshot = juce::roundToInt (getSampleRate() / meterSnapshotsPerSecond);
+    
+    const auto& reference = engines.getReference();
+    const auto mode = static_cast<jafftune::OperationMode> (operationMode);
+    
+    pendingSnapshot.phasor = reference.getPhasorPosition();
+    pendingSnapshot.showsGrains = mode != jafftune::OperationMode::monoBypass
+                               && mode != jafftune::OperationMode::stereoBypass
+                               && mode != jafftune::OperationMode::harmonizer
+                               && ! reference.runsPhaseVocoder (mode);
+    
+    const auto correcting = mode == jafftune::OperationMode::pitchCorrection;
+    pendingSnapshot.detectedFrequency = correcting ? reference.getDetectedFrequency() : 0.0f;
+    pendingSnapshot.correctionSemitones = correcting ? reference.getCorrectionSemitones() : 0.0f;
+    
+    //a full ring means the editor is behind; this snapshot is dropped and the next starts afresh either way
+    meterSnapshots.push (pendingSnapshot);
+    pendingSnapshot = {};
+}
+
+template <typename SampleType>
+void JafftuneAudioProcessor::configureEngine (jafftune::PitchShiftEngine<SampleType>& target, float window, int operationMode)
+{
+    target.setDelayWindow (window);
+    
+    //Adaptive Window reports the taps' latency, so the dry signal is delayed to match it
+    target.setLatencyCompensation (usesAdaptiveWindow (operationMode));
+    
+    //Harmonizer voices
+    if (operationMode == static_cast<int> (jafftune::OperationMode::harmonizer))
+    {
+        target.setNumHarmonyVoices (static_cast<int> (harmonyVoicesParameter->load()));
+        
+        for (int v = 0; v < jafftune::PitchShiftEngine<SampleType>::maxHarmonyVoices; ++v)
+            target.setHarmonyVoice (v,
+                                    voiceRatioParameters[v]->load(),
+                                    voiceGains[v] (voiceGainParameters[v]->load()),
+                                    voicePanParameters[v]->load());
+    }
+    
+    //Pitch correction (snaps the detected pitch to the chosen key and scale)
+    if (operationMode == static_cast<int> (jafftune::OperationMode::pitchCorrection))
+    {
+        target.setPitchCorrection (static_cast<jafftune::Scale> (static_cast<int> (correctionScaleParameter->load())),
+                                   static_cast<int> (correctionKeyParameter->load()),
+                                   retuneSpeedParameter->load());
+    }
     
     //Blend Control
-        float blendFactor = treeState.getRawParameterValue ("Blend")->load();
+        float blendFactor = blendParameter->load();
         float dryGain = scale (100 - blendFactor, 0.0f, 100.0f, 0.0f, 1.0f);
         float wetGain = scale (blendFactor, 0.0f, 100.0f, 0.0f, 1.0f);
+        target.setMix (dryGain, wetGain);
     
     //Volume Control
-        float volFactor = dbtoa(treeState.getRawParameterValue ("Volume")->load());
+        target.setOutputGain (volumeGain (volumeParameter->load()));
+    
+    //Interpolation (0 = Linear, 1 = Hermite)
+        target.setInterpolation (static_cast<jafftune::Interpolation> (static_cast<int> (interpolationParameter->load())));
     
-    auto* inputL = buffer.getReadPointer (0);
-    auto* inputR = buffer.getReadPointer (1);
-    auto* outputL = buffer.getWritePointer (0);
-    auto* outputR = buffer.getWritePointer (1);
+    //Algorithm (0 = Variable Delay, 1 = Phase Vocoder) and the vocoder's frame size
+        target.setAlgorithm (static_cast<jafftune::Algorithm> (static_cast<int> (algorithmParameter->load())));
+        target.setVocoderQuality (static_cast<jafftune::VocoderQuality> (static_cast<int> (vocoderQualityParameter->load())));
     
-    for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
+    //Formant preservation (runs the mono and stereo modes on the vocoder) and its own formant ratio
+        target.setFormantPreservation (preserveFormantsParameter->load() >= 0.5f, formantRatioParameter->load());
+}
+
+bool JafftuneAudioProcessor::usesChannelEngines() const
+{
+    return channelModeParameter->load() >= 0.5f || getTotalNumOutputChannels() > 2;
+}
+
+float JafftuneAudioProcessor::getChannelRatio (int channel) const
+{
+    //Independent channels trim the shared ratio per channel; linked ones all follow it
+    if (channelModeParameter->load() < 0.5f || channel >= maxChannels)
+        return 1.0f;
+    
+    return channelRatioParameters[channel]->load();
+}
+
+template <typename SampleType>
+void JafftuneAudioProcessor::setPitchRatios (EngineGroup<SampleType>& group, float pitchRatio, bool immediate)
+{
+    if (! group.config.perChannel)
     {
-        if (operationMode == 0) {
-            //Mono Bypass
-            float inputSampleL = inputL[sample];
-            outputL[sample] = inputSampleL * volFactor;
-            //outputR[sample] = inputSampleL * volFactor //<- Uncomment for (mono->stereo) operation in Standalone Build
-        }
-        else if (operationMode == 1) {
-            //Stereo Bypass
-            float inputSampleL = inputL[sample];
-            float inputSampleR = inputR[sample];
-            outputL[sample] = inputSampleL * volFactor;
-            outputR[sample] = inputSampleR * volFactor;
-        }
-        else if (operationMode == 2) {
-            //Mono Operation
-            float inputSample = inputL[sample];
-            mDelayLineOne.pushSample(0, inputSample);
-            
-            if (pitchRatio < 1.0f ) {
-                globalPhasorTap = phasor.processSample( 0.0f );
-            }
-            else if (pitchRatio > 1.0f ){
-                globalPhasorTap = reversePhasor.processSample( 0.0f );
-            }
-            else {
-                globalPhasorTap = 0.0f;
-            }
-            
-            float phasorTap = globalPhasorTap;
-            
-            float delayOne = (phasorTap * msToSamps(delayWindow));
-            float delayTwo = (fmod(phasorTap + 0.5f, 1) * msToSamps(delayWindow));
-            float filteredDelayOne = onePole(delayOne, lastDelayTimeOne, 0.05f, getSampleRate());
-            float filteredDelayTwo = onePole(delayTwo, lastDelayTimeTwo, 0.05f, getSampleRate());
-            lastDelayTimeOne = filteredDelayOne;
-            lastDelayTimeTwo = filteredDelayTwo;
-            float delayTapOneL = mDelayLineOne.popSample(0, filteredDelayOne, false); //<- tapout1L
-            float delayTapTwoL = mDelayLineOne.popSample(0, filteredDelayTwo, true); //<- tapout2L
-            float gainWindowOne = cosf((((phasorTap - 0.5f) / 2.0f)) * 2.0f * pi);
-            float gainWindowTwo = cosf(((fmod((phasorTap + 0.5f), 1) - 0.5f) / 2.0f) * 2 * pi);
-            
-            float outputSample = ((((delayTapOneL * gainWindowOne) + delayTapTwoL * gainWindowTwo ) * wetGain ) + (inputSample * dryGain));
-            outputL[sample] = outputSample * volFactor;
-            //outputR[sample] = outputSample * volFactor; //<- Uncomment for (mono->stereo) operation in Standalone Build
-        }
-        else if (operationMode == 3) {
-            //Stereo Operation (Wet L, Wet R)
-            float inputSampleL = inputL[sample];
-            float inputSampleR = inputR[sample];
-            mDelayLineOne.pushSample(0, inputSampleL);
-            mDelayLineOne.pushSample(1, inputSampleR);
-            
-            if (pitchRatio < 1.0f ) {
-                globalPhasorTap = phasor.processSample( 0.0f );
-            }
-            else if (pitchRatio > 1.0f ){
-                globalPhasorTap = reversePhasor.processSample( 0.0f );
-            }
-            else {
-                globalPhasorTap = 0.0f;
-            }
-            
-            float phasorTap = globalPhasorTap;
-            
-            float delayOne = (phasorTap * msToSamps(delayWindow));
-            float delayTwo = (fmod(phasorTap + 0.5f, 1) * msToSamps(delayWindow));
-            float filteredDelayOne = onePole(delayOne, lastDelayTimeOne, 0.05f, getSampleRate());
-            float filteredDelayTwo = onePole(delayTwo, lastDelayTimeTwo, 0.05f, getSampleRate());
-            lastDelayTimeOne = filteredDelayOne;
-            lastDelayTimeTwo = filteredDelayTwo;
-            float delayTapOneL = mDelayLineOne.popSample(0, filteredDelayOne, false); //<- tapout1L
-            float delayTapOneR = mDelayLineOne.popSample(1, filteredDelayOne, false); //<- tapout1R
-            float delayTapTwoL = mDelayLineOne.popSample(0, filteredDelayTwo, true); //<- tapout2L
-            float delayTapTwoR = mDelayLineOne.popSample(1, filteredDelayTwo, true); //<- tapout2R
-            float gainWindowOne = cosf((((phasorTap - 0.5f) / 2.0f)) * 2.0f * pi);
-            float gainWindowTwo = cosf(((fmod((phasorTap + 0.5f), 1) - 0.5f) / 2.0f) * 2 * pi);
-            
-            float outputSampleL = ((((delayTapOneL * gainWindowOne) + delayTapTwoL * gainWindowTwo ) * wetGain ) + (inputSampleL * dryGain));
-            float outputSampleR = ((((delayTapOneR * gainWindowOne) + delayTapTwoR * gainWindowTwo ) * wetGain ) + (inputSampleR * dryGain));
-            outputL[sample] = outputSampleL * volFactor;
-            outputR[sample] = outputSampleR * volFactor;
+        group.engines.front().setPitchRatio (pitchRatio, immediate);
+        return;
+    }
+    
+    for (size_t ch = 0; ch < group.engines.size(); ++ch)
+        group.engines[ch].setPitchRatio (juce::jlimit (0.5f, 2.0f, pitchRatio * getChannelRatio (static_cast<int> (ch))), immediate);
+}
+
+template <typename SampleType>
+void JafftuneAudioProcessor::setDelayWindows (EngineGroup<SampleType>& group, float window)
+{
+    for (auto& target : group.engines)
+        target.setDelayWindow (window);
+}
+
+bool JafftuneAudioProcessor::usesAdaptiveWindow (int operationMode) const
+{
+    //the harmonizer's voices each have their own ratio, so they keep the fixed window
+    return adaptiveWindowParameter->load() >= 0.5f
+        && operationMode != static_cast<int> (jafftune::OperationMode::harmonizer);
+}
+
+float JafftuneAudioProcessor::getDelayWindowFor (int operationMode, float ratio) const
+{
+    if (! usesAdaptiveWindow (operationMode))
+        return delayWindow;
+    
+    //latency is half the window, so the ceiling allows a window twice as long
+    return jafftune::PitchShiftEngine<float>::windowForRatio (ratio, 2.0f * latencyCeilingParameter->load());
+}
+
+template <typename SampleType>
+void JafftuneAudioProcessor::processEngine (EngineSet<SampleType>& engines, juce::AudioBuffer<SampleType>& buffer,
+                                            int startSample, int numSamples, jafftune::OperationMode mode)
+{
+    if (numSamples <= 0)
+        return;
+    
+    SampleType* channels[maxChannels] = {};
+    const auto numChannels = juce::jmin (buffer.getNumChannels(), maxChannels);
+    auto* oversampler = engines.oversampler.get();
+    
+    if (oversampler == nullptr)
+    {
+        for (int ch = 0; ch < numChannels; ++ch)
+            channels[ch] = buffer.getWritePointer (ch, startSample);
+        
+        runEngines (engines.getActive(), channels, numChannels, numSamples, mode);
+        return;
+    }
+    
+    //the up and down filters keep their state across calls, so a block split at MIDI events streams through them
+    const auto numOversampledChannels = juce::jmin (numChannels, oversampledChannels);
+    juce::dsp::AudioBlock<SampleType> block (buffer.getArrayOfWritePointers(), static_cast<size_t> (numOversampledChannels),
+                                             static_cast<size_t> (startSample), static_cast<size_t> (numSamples));
+    
+    auto oversampled = oversampler->processSamplesUp (block);
+    
+    for (int ch = 0; ch < numOversampledChannels; ++ch)
+        channels[ch] = oversampled.getChannelPointer (static_cast<size_t> (ch));
+    
+    runEngines (engines.getActive(), channels, numOversampledChannels, static_cast<int> (oversampled.getNumSamples()), mode);
+    oversampler->processSamplesDown (block);
+}
+
+template <typename SampleType>
+void JafftuneAudioProcessor::runEngines (EngineGroup<SampleType>& group, SampleType* const* channels, int numChannels,
+                                         int numSamples, jafftune::OperationMode mode)
+{
+    if (! group.config.perChannel)
+    {
+        //the engine only touches the first two channels
+        SampleType* stereo[2] = { channels[0], numChannels > 1 ? channels[1] : nullptr };
+        group.engines.front().process (stereo, juce::jmin (2, numChannels), numSamples, mode);
+        return;
+    }
+    
+    //per channel, the stereo modes become their mono equivalents on every channel (Dry L, Wet R
+    //has no multichannel counterpart, so it shifts every channel too); the mono modes keep to the first
+    ChannelBatch<SampleType> batch;
+    batch.group = &group;
+    batch.numSamples = numSamples;
+    
+    auto numActive = juce::jmin (numChannels, static_cast<int> (group.engines.size()));
+    
+    switch (mode)
+    {
+        case jafftune::OperationMode::monoBypass:
+        case jafftune::OperationMode::mono:             numActive = juce::jmin (1, numActive); batch.mode = mode; break;
+        case jafftune::OperationMode::stereoBypass:     batch.mode = jafftune::OperationMode::monoBypass; break;
+        case jafftune::OperationMode::stereoWetWet:
+        case jafftune::OperationMode::stereoDryWet:     batch.mode = jafftune::OperationMode::mono; break;
+        case jafftune::OperationMode::harmonizer:
+        case jafftune::OperationMode::pitchCorrection:
+        case jafftune::OperationMode::numModes:
+        default:                                        batch.mode = mode; break;
+    }
+    
+    for (int ch = 0; ch < numActive; ++ch)
+        batch.channels[ch] = channels[ch];
+    
+    //runs inline when there are no helper threads
+    workerPool.run (&processChannel<SampleType>, &batch, numActive);
+}
+
+template <typename SampleType>
+void JafftuneAudioProcessor::processChannel (void* context, int channel)
+{
+    //may run on a helper thread, which needs its own denormal flushing
+    juce::ScopedNoDenormals noDenormals;
+    
+    auto& batch = *static_cast<ChannelBatch<SampleType>*> (context);
+    SampleType* io[] = { batch.channels[channel] };
+    batch.group->engines[static_cast<size_t> (channel)].process (io, 1, batch.numSamples, batch.mode);
+}
+
+bool JafftuneAudioProcessor::oversamplingChanged() const
+{
+    const auto stages = static_cast<int> (oversamplingParameter->load());
+    const auto filter = static_cast<int> (oversamplingFilterParameter->load());
+    
+    //the filter choice only matters while oversampling
+    return stages != oversamplingStages || (stages > 0 && filter != oversamplingFilter);
+}
+
+void JafftuneAudioProcessor::timerCallback()
+{
+    if (const auto latency = pendingLatency.load (std::memory_order_relaxed); latency != getLatencySamples())
+        setLatencySamples (latency);
+    
+    if (getSampleRate() <= 0.0)
+        return;
+    
+    //Oversampling changes take effect once they are prepared here; until then the old setting runs
+    if (oversamplingChanged())
+    {
+        //the callback lock keeps processBlock out while the engines are prepared at the new rate
+        suspendProcessing (true);
+        prepareToPlay (getSampleRate(), getBlockSize());
+        suspendProcessing (false);
+        return;
+    }
+    
+    //Channel Mode, vocoder and window changes are prepared alongside the running engines, which keep going
+    //until they're ready (with the Phase Vocoder chosen but not yet built, on the delay taps, and with a
+    //longer window than their history holds, on the longest it does)
+    if (preparedDoublePrecision)
+        prepareStandby (doubleEngines);
+    else
+        prepareStandby (floatEngines);
+}
+
+template <typename SampleType>
+int JafftuneAudioProcessor::getTotalLatency (int operationMode, const EngineSet<SampleType>& engines) const
+{
+    //the vocoder and, in Adaptive Window mode, the delay taps delay their dry signal to match;
+    //bypass and the fixed window add no latency
+    const auto& reference = engines.getReference();
+    const auto engineLatency = reference.getLatencyInSamples (static_cast<jafftune::OperationMode> (operationMode));
+    
+    auto latency = static_cast<float> (engineLatency) / static_cast<float> (1 << oversamplingStages);
+    
+    if (engines.oversampler != nullptr)
+        latency += static_cast<float> (engines.oversampler->getLatencyInSamples());
+    
+    return juce::roundToInt (latency);
+}
+
+template <typename SampleType>
+double JafftuneAudioProcessor::getTailLength (int operationMode, const EngineSet<SampleType>& engines) const
+{
+    const auto sampleRate = getSampleRate();
+    
+    if (sampleRate <= 0.0)
+        return 0.0;
+    
+    //the engines' tail is at the oversampled rate; the filters' own latency rings on after it
+    const auto& reference = engines.getReference();
+    auto tail = static_cast<double> (reference.getTailLengthInSamples (static_cast<jafftune::OperationMode> (operationMode)))
+              / static_cast<double> (1 << oversamplingStages);
+    
+    if (engines.oversampler != nullptr)
+        tail += static_cast<double> (engines.oversampler->getLatencyInSamples());
+    
+    return tail / sampleRate;
+}
+
+//==============================================================================
+bool JafftuneAudioProcessor::handleMidiMessage (const juce::MidiMessage& message)
+{
+    if (message.isNoteOn())
+    {
+        //move the note to the top of the stack, dropping the oldest if it's full
+        const auto note = message.getNoteNumber();
+        const auto end = std::remove (heldNotes, heldNotes + numHeldNotes, note);
+        numHeldNotes = static_cast<int> (end - heldNotes);
+        
+        if (numHeldNotes == maxHeldNotes)
+        {
+            std::copy (heldNotes + 1, heldNotes + maxHeldNotes, heldNotes);
+            --numHeldNotes;
         }
-        else {
-            //Stereo Operation (Dry L, Wet R)
-            float inputSampleL = inputL[sample];
-            float inputSampleR = inputR[sample];
-            mDelayLineOne.pushSample(0, inputSampleL);
-            mDelayLineOne.pushSample(1, inputSampleR);
-            
-            if (pitchRatio < 1.0f ) {
-                globalPhasorTap = phasor.processSample( 0.0f );
-            }
-            else if (pitchRatio > 1.0f ){
-                globalPhasorTap = reversePhasor.processSample( 0.0f );
-            }
-            else {
-                globalPhasorTap = 0.0f;
-            }
-            
-            float phasorTap = globalPhasorTap;
-            
-            float delayOne = (phasorTap * msToSamps(delayWindow));
-            float delayTwo = (fmod(phasorTap + 0.5f, 1) * msToSamps(delayWindow));
-            float filteredDelayOne = onePole(delayOne, lastDelayTimeOne, 0.05f, getSampleRate());
-            float filteredDelayTwo = onePole(delayTwo, lastDelayTimeTwo, 0.05f, getSampleRate());
-            lastDelayTimeOne = filteredDelayOne;
-            lastDelayTimeTwo = filteredDelayTwo;
-            float delayTapOneL = mDelayLineOne.popSample(0, filteredDelayOne, false); //<- tapout1L
-            float delayTapOneR = mDelayLineOne.popSample(1, filteredDelayOne, false); //<- tapout1R
-            float delayTapTwoL = mDelayLineOne.popSample(0, filteredDelayTwo, true); //<- tapout2L
-            float delayTapTwoR = mDelayLineOne.popSample(1, filteredDelayTwo, true); //<- tapout2R
-            float gainWindowOne = cosf((((phasorTap - 0.5f) / 2.0f)) * 2.0f * pi);
-            float gainWindowTwo = cosf(((fmod((phasorTap + 0.5f), 1) - 0.5f) / 2.0f) * 2 * pi);
-            
-            float outputSampleL = ((((delayTapOneL * gainWindowOne) + delayTapTwoL * gainWindowTwo ) * wetGain ) + (inputSampleL * dryGain));
-            float outputSampleR = ((((delayTapOneR * gainWindowOne) + delayTapTwoR * gainWindowTwo ) * wetGain ) + (inputSampleR * dryGain));
-            outputL[sample] = ((inputSampleL + inputSampleR) / 2.0f) * volFactor;
-            outputR[sample] = ((outputSampleL + outputSampleR) / 2.0f) * volFactor;
+        
+        heldNotes[numHeldNotes++] = note;
+        midiNote = note;
+        return true;
+    }
+    
+    if (message.isNoteOff())
+    {
+        //releasing the sounding note falls back to the newest one still held;
+        //releasing the last one keeps the ratio where it is
+        const auto end = std::remove (heldNotes, heldNotes + numHeldNotes, message.getNoteNumber());
+        numHeldNotes = static_cast<int> (end - heldNotes);
+        
+        if (numHeldNotes > 0 && midiNote != heldNotes[numHeldNotes - 1])
+        {
+            midiNote = heldNotes[numHeldNotes - 1];
+            return true;
         }
+        
+        return false;
+    }
+    
+    if (message.isPitchWheel())
+    {
+        pitchBend = juce::jlimit (-1.0f, 1.0f, (message.getPitchWheelValue() - 8192) / 8192.0f);
+        return true;
     }
+    
+    if (message.isAllNotesOff() || message.isAllSoundOff())
+        numHeldNotes = 0;
+    
+    return false;
+}
+
+float JafftuneAudioProcessor::getMidiPitchRatio() const
+{
+    //semitones from the reference note, plus the bend, limited to the Pitch Ratio range
+    const auto referenceNote = referenceNoteParameter->load();
+    const auto note = midiNote >= 0 ? static_cast<float> (midiNote) : referenceNote;
+    const auto semitones = note - referenceNote + pitchBend * pitchBendRangeParameter->load();
+    
+    return juce::jlimit (0.5f, 2.0f, std::pow (2.0f, semitones / 12.0f));
 }
 
 //==============================================================================
@@ -316,22 +860,115 @@ bool JafftuneAudioProcessor::hasEditor() const
 
 juce::AudioProcessorEditor* JafftuneAudioProcessor::createEditor()
 {
-    //return new JafftuneAudioProcessorEditor (*this);
-    return new juce::GenericAudioProcessorEditor (*this);
+    return new JafftuneAudioProcessorEditor (*this);
 }
 
 //==============================================================================
 void JafftuneAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
+   #if JAFFTUNE_XML_STATE
+    if (auto xml = treeState.copyState().createXml())
+        copyXmlToBinary (*xml, destData);
+   #else
+    //header, then tagged chunks with their sizes, so a reader can skip the ones it doesn't know
+    juce::MemoryOutputStream stream (destData, false);
+    stream.writeInt (stateMagic);
+    stream.writeShort (static_cast<short> (stateVersion));
+    
+    //parameters by ID with their real (not normalised) values, so added, removed, reordered
+    //or re-ranged parameters still restore
+    juce::MemoryOutputStream parameters;
+    
+    for (auto* parameter : getParameters())
+    {
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (parameter))
+        {
+            parameters.writeString (ranged->paramID);
+            parameters.writeFloat (ranged->convertFrom0to1 (ranged->getValue()));
+        }
+    }
+    
+    stream.writeInt (parameterChunk);
+    stream.writeInt (static_cast<int> (parameters.getDataSize()));
+    stream.write (parameters.getData(), parameters.getDataSize());
+   #endif
 }
 
 void JafftuneAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
+    //parameters are set one by one through their atomics, which processBlock can read at any time;
+    //an Oversampling change is picked up and prepared on the message thread as usual
+    if (readBinaryState (data, sizeInBytes))
+        return;
+    
+    //XML, as written by JAFFTUNE_XML_STATE builds
+    if (auto xml = getXmlFromBinary (data, sizeInBytes))
+        if (xml->hasTagName (treeState.state.getType()))
+            treeState.replaceState (juce::ValueTree::fromXml (*xml));
+}
+
+bool JafftuneAudioProcessor::readBinaryState (const void* data, int sizeInBytes)
+{
+    juce::MemoryInputStream stream (data, static_cast<size_t> (juce::jmax (0, sizeInBytes)), false);
+    
+    if (sizeInBytes < 6 || stream.readInt() != stateMagic)
+        return false;
+    
+    //newer versions only add chunks, so any version reads as far as this one understands
+    stream.readShort();
+    
+    while (stream.getNumBytesRemaining() >= 8)
+    {
+        const auto tag = stream.readInt();
+        const auto size = stream.readInt();
+        const auto start = stream.getPosition();
+        
+        if (size < 0 || size > stream.getNumBytesRemaining())
+            break;
+        
+        if (tag == parameterChunk)
+        {
+            juce::MemoryInputStream chunk (static_cast<const char*> (data) + start, static_cast<size_t> (size), false);
+            readParameterChunk (chunk);
+        }
+        
+        stream.setPosition (start + size);
+    }
+    
+    return true;
+}
+
+void JafftuneAudioProcessor::readParameterChunk (juce::MemoryInputStream& chunk)
+{
+    const auto& parameters = getParameters();
+    juce::Array<bool> restored;
+    restored.insertMultiple (0, false, parameters.size());
+    
+    //only parameters whose value actually changes are set, so the host isn't flooded on session loads
+    auto apply = [] (juce::RangedAudioParameter& parameter, float normalisedValue)
+    {
+        if (parameter.getValue() != normalisedValue)
+            parameter.setValueNotifyingHost (normalisedValue);
+    };
+    
+    while (! chunk.isExhausted())
+    {
+        const auto id = chunk.readString();
+        const auto value = chunk.readFloat();
+        
+        //IDs this version doesn't have came from a newer one and are skipped
+        if (auto* parameter = treeState.getParameter (id))
+        {
+            apply (*parameter, parameter->convertTo0to1 (value));
+            restored.set (parameter->getParameterIndex(), true);
+        }
+    }
+    
+    //parameters the state predates go back to their defaults, so loading is repeatable
+    for (auto* parameter : parameters)
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (parameter))
+            if (! restored[ranged->getParameterIndex()])
+                apply (*ranged, ranged->getDefaultValue());
 }
 
 //Add sliders to layout below
@@ -359,7 +996,7 @@ juce::AudioProcessorValueTreeState::ParameterLayout
         
         //adds binary option for Stereo and Mono modes (not implemented)
         juce::StringArray stringArray;
-        for( int i = 0; i < 5; ++i )
+        for( int i = 0; i < 7; ++i )
         {
             juce::String str;
             if (i == 0) {
@@ -374,14 +1011,109 @@ juce::AudioProcessorValueTreeState::ParameterLayout
             else if (i == 3) {
                 str << "Stereo (Wet L, Wet R)";
             }
-            else {
+            else if (i == 4) {
                 str << "Stereo (Dry L, Wet R)";
             }
+            else if (i == 5) {
+                str << "Harmonizer";
+            }
+            else {
+                str << "Pitch Correction";
+            }
             stringArray.add(str);
         }
         
         layout.add(std::make_unique<juce::AudioParameterChoice>("Operation Mode", "Operation Mode", stringArray, 0));
         
+        //adds harmonizer voices (used in Harmonizer mode), defaulting to a stack of common intervals
+        layout.add(std::make_unique<juce::AudioParameterInt>("Harmony Voices", "Harmony Voices",
+        1, jafftune::PitchShiftEngine<float>::maxHarmonyVoices, 2));
+        
+        const int defaultVoiceSemitones[] = { 4, 7, 12, -12, -5, 3, -8, 9 };
+        
+        for (int v = 0; v < jafftune::PitchShiftEngine<float>::maxHarmonyVoices; ++v)
+        {
+            const juce::String voice = "Voice " + juce::String (v + 1);
+            const float defaultRatio = std::pow (2.0f, defaultVoiceSemitones[v] / 12.0f);
+            const float defaultPan = (v % 2 == 0) ? -0.5f : 0.5f;
+            
+            layout.add(std::make_unique<juce::AudioParameterFloat>(voice + " Ratio",
+            voice + " Ratio",
+            juce::NormalisableRange<float>(0.5, 2.f, 0.001, 1.f), defaultRatio));
+            
+            layout.add(std::make_unique<juce::AudioParameterFloat>(voice + " Gain",
+            voice + " Gain",
+            juce::NormalisableRange<float>(-60.0f, 0.0f, 1.f, 1.f), -6.0f));
+            
+            layout.add(std::make_unique<juce::AudioParameterFloat>(voice + " Pan",
+            voice + " Pan",
+            juce::NormalisableRange<float>(-1.0f, 1.0f, 0.01f, 1.f), defaultPan));
+        }
+        
+        //adds pitch correction key, scale and retune speed (used in Pitch Correction mode)
+        layout.add(std::make_unique<juce::AudioParameterChoice>("Correction Key", "Correction Key",
+        juce::StringArray { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" }, 0));
+        
+        layout.add(std::make_unique<juce::AudioParameterChoice>("Correction Scale", "Correction Scale",
+        juce::StringArray { "Chromatic", "Major", "Natural Minor", "Harmonic Minor", "Major Pentatonic", "Minor Pentatonic" }, 0));
+        
+        layout.add(std::make_unique<juce::AudioParameterFloat>("Retune Speed",
+        "Retune Speed",
+        juce::NormalisableRange<float>(0.0f, 400.0f, 1.f, 0.5f), 50.0f));
+        
+        //adds MIDI control of the pitch ratio: notes set it relative to the reference note, plus pitch bend
+        layout.add(std::make_unique<juce::AudioParameterBool>("MIDI Control", "MIDI Control", false));
+        
+        layout.add(std::make_unique<juce::AudioParameterInt>("Reference Note", "Reference Note", 0, 127, 60));
+        
+        layout.add(std::make_unique<juce::AudioParameterInt>("Pitch Bend Range", "Pitch Bend Range", 0, 24, 2));
+        
+        //adds the adaptive window, sized from the pitch ratio, and the most latency it may add
+        layout.add(std::make_unique<juce::AudioParameterBool>("Adaptive Window", "Adaptive Window", false));
+        
+        layout.add(std::make_unique<juce::AudioParameterFloat>("Latency Ceiling",
+        "Latency Ceiling",
+        juce::NormalisableRange<float>(jafftune::PitchShiftEngine<float>::minimumAdaptiveWindow / 2.0f, maximumLatencyCeiling, 1.f, 1.f), 25.0f));
+        
+        //adds independent pitch control per channel: each channel's ratio trims the shared one
+        layout.add(std::make_unique<juce::AudioParameterChoice>("Channel Mode", "Channel Mode",
+        juce::StringArray { "Linked", "Independent" }, 0));
+        
+        for (int ch = 0; ch < maxChannels; ++ch)
+        {
+            const juce::String channel = "Channel " + juce::String (ch + 1);
+            
+            layout.add(std::make_unique<juce::AudioParameterFloat>(channel + " Ratio",
+            channel + " Ratio",
+            juce::NormalisableRange<float>(0.5, 2.f, 0.001, 1.f), 1.0f));
+        }
+        
+        //adds optional oversampling around the engine: polyphase IIR for low latency, FIR for linear phase
+        layout.add(std::make_unique<juce::AudioParameterChoice>("Oversampling", "Oversampling",
+        juce::StringArray { "Off", "2x", "4x" }, 0));
+        
+        layout.add(std::make_unique<juce::AudioParameterChoice>("Oversampling Filter", "Oversampling Filter",
+        juce::StringArray { "Polyphase IIR", "Linear Phase FIR" }, 0));
+        
+        //adds a phase vocoder alternative to the delay taps for the mono and stereo modes,
+        //with its frame size traded between latency and quality
+        layout.add(std::make_unique<juce::AudioParameterChoice>("Algorithm", "Algorithm",
+        juce::StringArray { "Variable Delay", "Phase Vocoder" }, 0));
+        
+        layout.add(std::make_unique<juce::AudioParameterChoice>("Vocoder Quality", "Vocoder Quality",
+        juce::StringArray { "Low Latency", "Balanced", "High Quality" }, 1));
+        
+        //adds formant preservation on the vocoder, with the formants movable independently of the pitch
+        layout.add(std::make_unique<juce::AudioParameterBool>("Preserve Formants", "Preserve Formants", false));
+        
+        layout.add(std::make_unique<juce::AudioParameterFloat>("Formant Ratio",
+        "Formant Ratio",
+        juce::NormalisableRange<float>(0.5, 2.f, 0.001, 1.f), 1.0f));
+        
+        //adds option for the delay tap interpolation (Linear is the original behaviour)
+        layout.add(std::make_unique<juce::AudioParameterChoice>("Interpolation", "Interpolation",
+        juce::StringArray { "Linear", "Hermite" }, 0));
+        
         return layout;
     }
 
@@ -7,8 +7,6 @@
     
     YET TO IMPLEMENT:
     -Allow user to type values into sliders
-    -Independent Pitch Control per Channel in Stereo Mode
-    -Resolve delayWindow to a function of pitchRatio to keep phasorFreq < 5
     -Build and codesign Windows Installer
     -Add CMake support
  
@@ -18,6 +16,11 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "Engine/PitchShiftEngine.h"
+#include "Engine/AllocationTracker.h"
+#include "Engine/PerformanceMonitor.h"
+#include "Engine/SpscRing.h"
+#include "Engine/WorkerPool.h"
 
 //==============================================================================
 /**
@@ -26,6 +29,7 @@ class JafftuneAudioProcessor  : public juce::AudioProcessor
                             #if JucePlugin_Enable_ARA
                              , public juce::AudioProcessorARAExtension
                             #endif
+                             , private juce::Timer
 {
 public:
     //==============================================================================
@@ -41,6 +45,8 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override;
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -68,6 +74,24 @@ public:
     static juce::AudioProcessorValueTreeState::ParameterLayout
     createParameterLayout();
     juce::AudioProcessorValueTreeState treeState {*this, nullptr, "Parameters", createParameterLayout()};
+    
+    //processBlock timing, read by the editor (its collect() is for one reader only)
+    jafftune::PerformanceMonitor& getPerformanceMonitor() noexcept { return performanceMonitor; }
+    
+    //what the editor displays, gathered over about a 60th of a second of audio
+    struct MeterSnapshot
+    {
+        float inputPeak[2] = {};            // first two channels, linear
+        float outputPeak[2] = {};
+        float phasor = 0.0f;                // first tap's position across the delay window, 0 to 1
+        float detectedFrequency = 0.0f;     // Hz, 0 = unvoiced or not detecting
+        float correctionSemitones = 0.0f;
+        bool showsGrains = false;           // the delay taps are shifting (not bypassed, harmonizer or vocoder)
+    };
+    
+    //nothing is measured until an editor asks, and snapshots are only taken off by that one editor
+    void setMeteringActive (bool shouldMeter) noexcept { meteringActive.store (shouldMeter, std::memory_order_relaxed); }
+    bool popMeterSnapshot (MeterSnapshot& snapshot) noexcept { return meterSnapshots.pop (snapshot); }
         
 private:
     
@@ -79,48 +103,249 @@ private:
         return scaledValue;
     }
     
-    float msToSamps(float valueInMs) {
-        return valueInMs * (getSampleRate() / 1000);
+    static float dbtoa(float valueIndB) {
+        return std::pow(10.0f, valueIndB / 20.0f);
     }
     
-    float sampsToMs(float valueInSamps) {
-        return valueInSamps * (1000 / getSampleRate());
-    }
+    //dbtoa for one parameter, only recomputed when its value changes
+    struct CachedGain
+    {
+        float operator() (float valueIndB)
+        {
+            if (valueIndB != decibels)
+            {
+                decibels = valueIndB;
+                gain = dbtoa (valueIndB);
+            }
+            
+            return gain;
+        }
+        
+        float decibels = 1.0f;  // above every gain parameter's range, so the first call computes
+        float gain = dbtoa (1.0f);
+    };
     
-    float dbtoa(float valueIndB) {
-        return std::pow(10.0, valueIndB / 20.0);
-    }
+    CachedGain volumeGain;
+    CachedGain voiceGains[jafftune::PitchShiftEngine<float>::maxHarmonyVoices];
+    
+    //MIDI control of the pitch ratio: last-note priority plus pitch bend
+    bool handleMidiMessage (const juce::MidiMessage& message);
+    float getMidiPitchRatio() const;
+    
+    //the fixed delayWindow, or with Adaptive Window on, one sized from the ratio under the latency ceiling
+    float getDelayWindowFor (int operationMode, float ratio) const;
+    bool usesAdaptiveWindow (int operationMode) const;
     
-    //onePole from https://www.musicdsp.org/en/latest/Filters/257-1-pole-lpf-for-smooth-parameter-changes.html
-    float onePole (float inputSample, float pastSample, float smoothingTimeInMs, int sampleRate) {
-        const int twoPi = 2 * juce::MathConstants<float>::pi;
-        float a = exp( -twoPi / (smoothingTimeInMs * 0.001f * sampleRate));
-        float b = 1.0f - a;
-        float outputSample = (inputSample * b) + (pastSample * a);
-        return outputSample;
+    //what a group of engines is prepared as: one stereo engine, or a mono engine per channel for
+    //multichannel layouts and independent channel ratios, whether they build the phase vocoder
+    //(a few hundred kilobytes a channel, only needed for the Phase Vocoder algorithm or formants),
+    //and the longest window, in milliseconds, their history is sized for
+    struct EngineConfig
+    {
+        bool perChannel = false;
+        bool withVocoder = false;
+        float maximumWindow = 0.0f;
+        
+        bool operator== (const EngineConfig& other) const noexcept
+        {
+            return perChannel == other.perChannel && withVocoder == other.withVocoder
+                && maximumWindow == other.maximumWindow;
+        }
+        
+        bool operator!= (const EngineConfig& other) const noexcept { return ! operator== (other); }
     };
     
-    //initialzie mDelayLine
-    juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::Linear> mDelayLineOne { static_cast<int>(getSampleRate())};
+    template <typename SampleType>
+    struct EngineGroup
+    {
+        std::vector<jafftune::PitchShiftEngine<SampleType>> engines;
+        EngineConfig config;
+    };
+    
+    //the engines for one processing precision and the oversampler they run behind. Only the set matching
+    //the host's precision is prepared, and only its active group; when Channel Mode, the vocoder settings or
+    //the window ask for a different group, the message thread prepares it as the standby and the audio thread
+    //fades over to it.
+    template <typename SampleType>
+    struct EngineSet
+    {
+        EngineGroup<SampleType> groups[2];
+        int active = 0;                             // only moved by the audio thread, while standbyReady is set
+        std::atomic<bool> standbyReady { false };   // the standby is prepared, and the audio thread's until it clears this
+        bool handingOver = false;                   // audio thread only: the active group is fading out to bypass
+        jafftune::OperationMode handoverMode = jafftune::OperationMode::stereoBypass;
+        std::unique_ptr<juce::dsp::Oversampling<SampleType>> oversampler;
+        
+        EngineGroup<SampleType>& getActive() noexcept               { return groups[active]; }
+        const EngineGroup<SampleType>& getActive() const noexcept   { return groups[active]; }
+        EngineGroup<SampleType>& getStandby() noexcept              { return groups[1 - active]; }
+        
+        //every channel shares the window, so the first engine stands for them all
+        const jafftune::PitchShiftEngine<SampleType>& getReference() const { return getActive().engines.front(); }
+    };
+    
+    //processBlock for either precision
+    template <typename SampleType>
+    void process (juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiMessages, EngineSet<SampleType>& engines);
+    
+    template <typename SampleType>
+    void prepareEngines (EngineSet<SampleType>& engines, double sampleRate, int samplesPerBlock, bool reuseBuffers);
+    
+    template <typename SampleType>
+    void prepareGroup (EngineGroup<SampleType>& group, const EngineConfig& config, bool reuseBuffers);
+    
+    //the group the parameters and layout call for, keeping the current one's window while it's close enough
+    EngineConfig getWantedConfig (const EngineConfig& current) const;
+    
+    //message thread: prepares the standby group when the active one no longer suits, or frees it
+    template <typename SampleType>
+    void prepareStandby (EngineSet<SampleType>& engines);
+    
+    //audio thread: once the active group has faded out to bypass, the standby takes over from bypass
+    template <typename SampleType>
+    void handOver (EngineSet<SampleType>& engines, float pitchRatio, int operationMode);
+    
+    //prepareToPlay may come from a host thread while the message thread prepares a standby group
+    juce::CriticalSection preparationLock;
+    
+    //applies the parameters other than the pitch ratio to one engine
+    template <typename SampleType>
+    void configureEngine (jafftune::PitchShiftEngine<SampleType>& target, float window, int operationMode);
     
-    //initialzie oscillator gains
-    juce::dsp::Gain<float> phasorGain;
-    juce::dsp::Gain<float> reversePhasorGain;
-   
-    //declare global variables
-    const float pi = {juce::MathConstants<float>::pi};
-    float delayTime = { 0.0f };
+    //per-channel engines, with each channel's ratio trimming the shared one when Independent
+    bool usesChannelEngines() const;
+    float getChannelRatio (int channel) const;
+    
+    template <typename SampleType>
+    void setPitchRatios (EngineGroup<SampleType>& group, float pitchRatio, bool immediate = false);
+    
+    //a MIDI event's new window, between the full configureEngine calls at block starts
+    template <typename SampleType>
+    void setDelayWindows (EngineGroup<SampleType>& group, float window);
+    
+    //runs the active engine(s) over part of the buffer, so the block can be split at MIDI events,
+    //going through the oversampler when there is one
+    template <typename SampleType>
+    void processEngine (EngineSet<SampleType>& engines, juce::AudioBuffer<SampleType>& buffer, int startSample, int numSamples,
+                        jafftune::OperationMode mode);
+    
+    template <typename SampleType>
+    void runEngines (EngineGroup<SampleType>& group, SampleType* const* channels, int numChannels, int numSamples,
+                     jafftune::OperationMode mode);
+    
+    //a new Oversampling setting changes the engines' sample rate, so it is prepared again on the message thread,
+    //which also passes on latency changes the audio thread finds; the audio thread only stores atomics and the
+    //message thread polls them, since waking it from the audio thread can lock or make a system call
+    bool oversamplingChanged() const;
+    void timerCallback() override;
+    
+    static constexpr int messageThreadPollsPerSecond = 30;
+    std::atomic<int> pendingLatency { 0 };
+    
+    //versioned binary state: a magic number and format version, then chunks of [tag, size, data]
+    static constexpr int stateMagic = 0x5354464a;       // "JFTS"
+    static constexpr int stateVersion = 1;
+    static constexpr int parameterChunk = 0x4d524150;   // "PARM"
+    
+    bool readBinaryState (const void* data, int sizeInBytes);
+    void readParameterChunk (juce::MemoryInputStream& chunk);
+    
+    //the oversampler's latency plus the engine's for the mode (converted back to the host rate)
+    template <typename SampleType>
+    int getTotalLatency (int operationMode, const EngineSet<SampleType>& engines) const;
+    
+    //how long the output rings on after the input stops, worked out with the latency and read by the host
+    template <typename SampleType>
+    double getTailLength (int operationMode, const EngineSet<SampleType>& engines) const;
+    
+    std::atomic<double> tailLengthSeconds { 0.0 };
+    
+    //pitch shifting engines (phasor~, delay taps and cosine windows), in single and double precision
+    EngineSet<float> floatEngines;
+    EngineSet<double> doubleEngines;
     float delayWindow = { 22.0f };
-    float pitchRatio = { 1.0f };
-    float globalPhasorTap = { 0.0f };
-    float lastDelayTimeOne = { 0.0f };
-    float lastDelayTimeTwo = { 0.0f };
-
-    //sawtooth oscillator -> replicates "phasor~"
-    juce::dsp::Oscillator<float> phasor { [](float x) { return ((x / juce::MathConstants<float>::pi) + 1.0f) / 2.0f; }};
+    static constexpr float maximumLatencyCeiling = 100.0f;
+    
+    //up to 7.1.4; with four or more channels a few helper threads take some of the channel engines
+    static constexpr int maxChannels = 12;
+    static constexpr int parallelChannelThreshold = 4;
+    static constexpr int maxWorkerThreads = 3;
+    jafftune::WorkerPool workerPool;
+    
+    //Oversampling: the engines run at 2x or 4x the host rate between the up and down filters
+    int oversamplingStages = 0;     // log2 of the factor
+    int oversamplingFilter = 0;     // 0 = polyphase IIR, 1 = linear phase FIR
+    int oversampledChannels = 0;
+    
+    //what the engines were last prepared for, so an unchanged prepare keeps their buffers
+    double preparedSampleRate = 0.0;
+    int preparedBlockSize = 0;
+    bool preparedDoublePrecision = false;
+    
+    //one channel of a per-channel block, run by the worker pool
+    template <typename SampleType>
+    struct ChannelBatch
+    {
+        EngineGroup<SampleType>* group = nullptr;
+        SampleType* channels[maxChannels] = {};
+        int numSamples = 0;
+        jafftune::OperationMode mode = jafftune::OperationMode::mono;
+    };
+    
+    template <typename SampleType>
+    static void processChannel (void* context, int channel);
+    
+    //always-on block timing and mode switch counts for the editor
+    jafftune::PerformanceMonitor performanceMonitor;
+    int lastOperationMode = -1;
+    
+    //meter snapshots for the editor: preallocated in the ring, dropped if the editor falls behind
+    static constexpr int meterSnapshotsPerSecond = 60;
+    jafftune::SpscRing<MeterSnapshot, 32> meterSnapshots;
+    std::atomic<bool> meteringActive { false };
+    MeterSnapshot pendingSnapshot;
+    int samplesUntilSnapshot = 0;
+    
+    template <typename SampleType>
+    static void accumulatePeaks (const juce::AudioBuffer<SampleType>& buffer, float* peaks);
+    
+    template <typename SampleType>
+    void publishMeters (const juce::AudioBuffer<SampleType>& buffer, const EngineSet<SampleType>& engines,
+                        int operationMode);
+    
+    //parameter values, read once per block
+    std::atomic<float>* pitchRatioParameter = nullptr;
+    std::atomic<float>* blendParameter = nullptr;
+    std::atomic<float>* volumeParameter = nullptr;
+    std::atomic<float>* operationModeParameter = nullptr;
+    std::atomic<float>* interpolationParameter = nullptr;
+    std::atomic<float>* harmonyVoicesParameter = nullptr;
+    std::atomic<float>* voiceRatioParameters[jafftune::PitchShiftEngine<float>::maxHarmonyVoices] = {};
+    std::atomic<float>* voiceGainParameters[jafftune::PitchShiftEngine<float>::maxHarmonyVoices] = {};
+    std::atomic<float>* voicePanParameters[jafftune::PitchShiftEngine<float>::maxHarmonyVoices] = {};
+    std::atomic<float>* correctionKeyParameter = nullptr;
+    std::atomic<float>* correctionScaleParameter = nullptr;
+    std::atomic<float>* retuneSpeedParameter = nullptr;
+    std::atomic<float>* midiControlParameter = nullptr;
+    std::atomic<float>* referenceNoteParameter = nullptr;
+    std::atomic<float>* pitchBendRangeParameter = nullptr;
+    std::atomic<float>* adaptiveWindowParameter = nullptr;
+    std::atomic<float>* latencyCeilingParameter = nullptr;
+    std::atomic<float>* channelModeParameter = nullptr;
+    std::atomic<float>* oversamplingParameter = nullptr;
+    std::atomic<float>* oversamplingFilterParameter = nullptr;
+    std::atomic<float>* algorithmParameter = nullptr;
+    std::atomic<float>* vocoderQualityParameter = nullptr;
+    std::atomic<float>* preserveFormantsParameter = nullptr;
+    std::atomic<float>* formantRatioParameter = nullptr;
+    std::atomic<float>* channelRatioParameters[maxChannels] = {};
     
-    //reverse sawtooth oscillator -> replicates "phasor~" when input freq is negative
-    juce::dsp::Oscillator<float> reversePhasor { [](float x) { return ((x / -juce::MathConstants<float>::pi) + 1.0f) / 2.0f; }};
+    //MIDI state (audio thread only)
+    static constexpr int maxHeldNotes = 16;
+    int heldNotes[maxHeldNotes] = {};
+    int numHeldNotes = 0;
+    int midiNote = -1;          // -1 until the first note, which leaves the ratio at the reference
+    float pitchBend = 0.0f;     // -1 to 1
     
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (JafftuneAudioProcessor)
@@ -0,0 +1,363 @@
+/*
+  ==============================================================================
+
+    JafftuneRender.cpp
+    Offline batch renderer: runs audio files through jafftune::PitchShiftEngine.
+
+        jafftune_render --output <dir> [options] <file or directory>...
+
+        --ratio r                  Pitch Ratio, 0.5 to 2.0 (default 1.0)
+        --blend percent            Blend, 0 to 100 (default 100, fully shifted)
+        --volume dB                Volume, -60 to 0 (default 0)
+        --mode m                   Operation Mode index, 0 to 6 (default 3)
+        --voice ratio:dB:pan       adds a Harmonizer voice (mode 5), up to 8
+        --key k --scale s          Correction Key (0 = C) and Scale index (mode 6)
+        --retune ms                Retune Speed (default 50)
+        --interpolation linear|hermite
+        --format wav|aiff|flac     output format (default: same as the input)
+        --block-size n             samples streamed per read (default 65536)
+        --tail                     also write what rings on past the end of the input
+        --threads n                worker threads (default: all cores)
+
+    Directories are searched recursively for every format JUCE can read, and
+    their layout is mirrored under the output directory. Files are streamed
+    block by block rather than loaded whole, and spread across a pool of
+    worker threads pulling from a shared queue. Each file and the batch as a
+    whole report throughput as a multiple of realtime.
+
+    Outputs line up sample for sample with their inputs: the engine's latency
+    is trimmed from the start and flushed out of the end with silence, so a
+    file comes out the same length unless --tail asks for the ringing too.
+
+  ==============================================================================
+*/
+
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include "../Engine/PitchShiftEngine.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+//==============================================================================
+struct HarmonyVoice
+{
+    float ratio = 1.0f;
+    float gainDb = -6.0f;
+    float pan = 0.0f;
+};
+
+struct RenderSettings
+{
+    float pitchRatio = 1.0f;
+    float blend = 100.0f;
+    float volume = 0.0f;
+    int operationMode = (int) jafftune::OperationMode::stereoWetWet;
+    jafftune::Interpolation interpolation = jafftune::Interpolation::linear;
+    std::vector<HarmonyVoice> voices;
+    int correctionKey = 0;
+    int correctionScale = 0;
+    float retuneSpeed = 50.0f;
+
+    juce::String outputFormat;
+    juce::File outputDirectory;
+    int blockSize = 65536;
+    int numThreads = 0;
+    bool keepTail = false;
+};
+
+struct RenderJob
+{
+    juce::File input, output;
+};
+
+struct RenderResult
+{
+    bool succeeded = false;
+    juce::String error;
+    double audioSeconds = 0.0;
+    double wallSeconds = 0.0;
+};
+
+//==============================================================================
+/** Streams one file through a freshly prepared engine. */
+RenderResult renderFile (const RenderJob& job, const RenderSettings& settings)
+{
+    RenderResult result;
+    const auto startTime = std::chrono::steady_clock::now();
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor (job.input));
+
+    if (reader == nullptr)
+    {
+        result.error = "unreadable input";
+        return result;
+    }
+
+    auto* outputFormat = formatManager.findFormatForFileExtension (job.output.getFileExtension());
+
+    if (outputFormat == nullptr)
+    {
+        result.error = "no writer for " + job.output.getFileExtension();
+        return result;
+    }
+
+    const auto numChannels = (int) reader->numChannels;
+    const auto bitsPerSample = outputFormat->getPossibleBitDepths().contains ((int) reader->bitsPerSample)
+                             ? (int) reader->bitsPerSample : 24;
+
+    job.output.getParentDirectory().createDirectory();
+    job.output.deleteFile();
+
+    std::unique_ptr<juce::OutputStream> stream (job.output.createOutputStream());
+    std::unique_ptr<juce::AudioFormatWriter> writer;
+
+    if (stream != nullptr)
+        writer.reset (outputFormat->createWriterFor (stream.get(), reader->sampleRate, (unsigned int) numChannels,
+                                                     bitsPerSample, reader->metadataValues, 0));
+
+    if (writer == nullptr)
+    {
+        result.error = "cannot create " + job.output.getFullPathName();
+        return result;
+    }
+
+    stream.release(); //now owned by the writer
+
+    //same parameter mapping as JafftuneAudioProcessor::processBlock
+    jafftune::PitchShiftEngine<float> engine;
+    engine.setPitchRatio (settings.pitchRatio);
+    engine.setMix ((100.0f - settings.blend) / 100.0f, settings.blend / 100.0f);
+    engine.setOutputGain (juce::Decibels::decibelsToGain (settings.volume, -100.0f));
+    engine.setInterpolation (settings.interpolation);
+    engine.setNumHarmonyVoices ((int) settings.voices.size());
+
+    for (size_t v = 0; v < settings.voices.size(); ++v)
+        engine.setHarmonyVoice ((int) v, settings.voices[v].ratio,
+                                juce::Decibels::decibelsToGain (settings.voices[v].gainDb, -100.0f),
+                                settings.voices[v].pan);
+
+    engine.setPitchCorrection (static_cast<jafftune::Scale> (settings.correctionScale),
+                               settings.correctionKey, settings.retuneSpeed);
+
+    //the dry signal is delayed along with the taps, so the whole output is late by the same amount
+    engine.setLatencyCompensation (true);
+    engine.prepare (reader->sampleRate, settings.blockSize, numChannels);
+
+    juce::AudioBuffer<float> buffer (numChannels, settings.blockSize);
+    const auto mode = static_cast<jafftune::OperationMode> (settings.operationMode);
+
+    //the latency is dropped from the start and made up with silence fed in after the input
+    const auto latency = (juce::int64) engine.getLatencyInSamples (mode);
+    const auto tail = settings.keepTail ? juce::jmax ((juce::int64) 0, (juce::int64) engine.getTailLengthInSamples (mode) - latency) : 0;
+    const auto numToProcess = reader->lengthInSamples + tail + latency;
+
+    for (juce::int64 position = 0; position < numToProcess;)
+    {
+        const auto numThisTime = (int) std::min ((juce::int64) settings.blockSize, numToProcess - position);
+        const auto numToRead = (int) juce::jlimit ((juce::int64) 0, (juce::int64) numThisTime, reader->lengthInSamples - position);
+
+        if (numToRead > 0 && ! reader->read (&buffer, 0, numToRead, position, true, true))
+        {
+            result.error = "read failed";
+            return result;
+        }
+
+        buffer.clear (numToRead, numThisTime - numToRead);
+        engine.process (buffer.getArrayOfWritePointers(), numChannels, numThisTime, mode);
+
+        const auto numSkipped = (int) juce::jlimit ((juce::int64) 0, (juce::int64) numThisTime, latency - position);
+
+        if (numSkipped < numThisTime && ! writer->writeFromAudioSampleBuffer (buffer, numSkipped, numThisTime - numSkipped))
+        {
+            result.error = "write failed";
+            return result;
+        }
+
+        position += numThisTime;
+    }
+
+    result.succeeded = true;
+    result.audioSeconds = (double) reader->lengthInSamples / reader->sampleRate;
+    result.wallSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now() - startTime).count();
+    return result;
+}
+
+//==============================================================================
+/** Expands the command line inputs into (input, output) pairs. */
+std::vector<RenderJob> collectJobs (const juce::StringArray& inputs, const RenderSettings& settings)
+{
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    const auto wildcard = formatManager.getWildcardForAllFormats();
+
+    std::vector<RenderJob> jobs;
+
+    auto addJob = [&] (const juce::File& input, const juce::String& relativePath)
+    {
+        auto output = settings.outputDirectory.getChildFile (relativePath);
+
+        if (settings.outputFormat.isNotEmpty())
+            output = output.withFileExtension (settings.outputFormat);
+
+        jobs.push_back ({ input, output });
+    };
+
+    for (const auto& path : inputs)
+    {
+        const auto input = juce::File::getCurrentWorkingDirectory().getChildFile (path);
+
+        if (input.isDirectory())
+        {
+            for (const auto& entry : juce::RangedDirectoryIterator (input, true, wildcard, juce::File::findFiles))
+                addJob (entry.getFile(), entry.getFile().getRelativePathFrom (input));
+        }
+        else if (input.existsAsFile())
+        {
+            addJob (input, input.getFileName());
+        }
+        else
+        {
+            std::fprintf (stderr, "skipping %s: not found\n", path.toRawUTF8());
+        }
+    }
+
+    return jobs;
+}
+
+//==============================================================================
+void printUsage()
+{
+    std::fprintf (stderr,
+                  "usage: jafftune_render --output <dir> [--ratio r] [--blend percent] [--volume dB]\n"
+                  "                       [--mode 0-6] [--voice ratio:dB:pan]... [--key 0-11] [--scale 0-5] [--retune ms]\n"
+                  "                       [--interpolation linear|hermite]\n"
+                  "                       [--format wav|aiff|flac] [--block-size n] [--threads n] [--tail]\n"
+                  "                       <file or directory>...\n");
+}
+
+bool parseArguments (int argc, char* argv[], RenderSettings& settings, juce::StringArray& inputs)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const juce::String arg (argv[i]);
+        const auto hasValue = i + 1 < argc;
+
+        if (arg == "--output" && hasValue)                 settings.outputDirectory = juce::File::getCurrentWorkingDirectory().getChildFile (argv[++i]);
+        else if (arg == "--ratio" && hasValue)             settings.pitchRatio = juce::jlimit (0.5f, 2.0f, (float) std::atof (argv[++i]));
+        else if (arg == "--blend" && hasValue)             settings.blend = juce::jlimit (0.0f, 100.0f, (float) std::atof (argv[++i]));
+        else if (arg == "--volume" && hasValue)            settings.volume = juce::jlimit (-60.0f, 0.0f, (float) std::atof (argv[++i]));
+        else if (arg == "--mode" && hasValue)              settings.operationMode = std::atoi (argv[++i]);
+        else if (arg == "--key" && hasValue)               settings.correctionKey = juce::jlimit (0, 11, std::atoi (argv[++i]));
+        else if (arg == "--scale" && hasValue)             settings.correctionScale = juce::jlimit (0, (int) jafftune::Scale::numScales - 1, std::atoi (argv[++i]));
+        else if (arg == "--retune" && hasValue)            settings.retuneSpeed = juce::jlimit (0.0f, 400.0f, (float) std::atof (argv[++i]));
+        else if (arg == "--format" && hasValue)            settings.outputFormat = juce::String (argv[++i]).trimCharactersAtStart (".");
+        else if (arg == "--block-size" && hasValue)        settings.blockSize = juce::jmax (256, std::atoi (argv[++i]));
+        else if (arg == "--threads" && hasValue)           settings.numThreads = juce::jmax (1, std::atoi (argv[++i]));
+        else if (arg == "--tail")                          settings.keepTail = true;
+        else if (arg == "--interpolation" && hasValue)
+            settings.interpolation = juce::String (argv[++i]) == "hermite" ? jafftune::Interpolation::hermite
+                                                                          : jafftune::Interpolation::linear;
+        else if (arg == "--voice" && hasValue)
+        {
+            if ((int) settings.voices.size() == jafftune::PitchShiftEngine<float>::maxHarmonyVoices)
+                return false;
+
+            const auto fields = juce::StringArray::fromTokens (argv[++i], ":", {});
+            HarmonyVoice voice;
+            voice.ratio = juce::jlimit (0.5f, 2.0f, fields[0].getFloatValue());
+            voice.gainDb = fields.size() > 1 ? juce::jlimit (-60.0f, 0.0f, fields[1].getFloatValue()) : voice.gainDb;
+            voice.pan = fields.size() > 2 ? juce::jlimit (-1.0f, 1.0f, fields[2].getFloatValue()) : voice.pan;
+            settings.voices.push_back (voice);
+        }
+        else if (arg.startsWith ("--"))
+            return false;
+        else
+            inputs.add (arg);
+    }
+
+    return settings.outputDirectory != juce::File()
+        && ! inputs.isEmpty()
+        && juce::isPositiveAndBelow (settings.operationMode, (int) jafftune::OperationMode::numModes);
+}
+
+} // namespace
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    RenderSettings settings;
+    juce::StringArray inputs;
+
+    if (! parseArguments (argc, argv, settings, inputs))
+    {
+        printUsage();
+        return 1;
+    }
+
+    const auto jobs = collectJobs (inputs, settings);
+
+    if (jobs.empty())
+    {
+        std::fprintf (stderr, "nothing to render\n");
+        return 1;
+    }
+
+    const auto numThreads = juce::jmin ((int) jobs.size(),
+                                        settings.numThreads > 0 ? settings.numThreads : juce::SystemStats::getNumCpus());
+
+    //work queue: each worker claims the next unrendered file until none are left
+    std::atomic<size_t> nextJob { 0 };
+    std::atomic<int> numFailed { 0 };
+    std::atomic<double> totalAudioSeconds { 0.0 };
+    const auto startTime = std::chrono::steady_clock::now();
+
+    auto worker = [&]
+    {
+        for (auto index = nextJob++; index < jobs.size(); index = nextJob++)
+        {
+            const auto& job = jobs[index];
+            const auto result = renderFile (job, settings);
+
+            if (result.succeeded)
+            {
+                for (auto total = totalAudioSeconds.load(); ! totalAudioSeconds.compare_exchange_weak (total, total + result.audioSeconds);) {}
+
+                std::printf ("%s -> %s (%.1fs audio, %.1fx realtime)\n",
+                             job.input.getFullPathName().toRawUTF8(), job.output.getFullPathName().toRawUTF8(),
+                             result.audioSeconds, result.audioSeconds / juce::jmax (1.0e-9, result.wallSeconds));
+            }
+            else
+            {
+                ++numFailed;
+                std::fprintf (stderr, "%s: %s\n", job.input.getFullPathName().toRawUTF8(), result.error.toRawUTF8());
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < numThreads; ++t)
+        threads.emplace_back (worker);
+
+    for (auto& thread : threads)
+        thread.join();
+
+    const auto wallSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now() - startTime).count();
+
+    std::printf ("rendered %d of %d files, %.1fs of audio in %.2fs on %d threads (%.1fx realtime)\n",
+                 (int) jobs.size() - numFailed.load(), (int) jobs.size(), totalAudioSeconds.load(),
+                 wallSeconds, numThreads, totalAudioSeconds.load() / juce::jmax (1.0e-9, wallSeconds));
+
+    return numFailed.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,804 @@
+/*
+  ==============================================================================
+
+    JafftuneServe.cpp
+    Headless pitch shifting service for many independent mono streams.
+
+        jafftune_serve [--socket path] [--sample-rate hz] [--max-streams n]
+                       [--max-window ms] [--threads n] [--batch n] [--report seconds]
+
+        jafftune_serve --loopback [--clients n] [--block-size n] [--seconds s]
+                       [--sample-rate hz] [--threads n] [--batch n]
+
+    Listens on a Unix domain socket. Each connection is one stream: the
+    client sends an OpenRequest, reads back an OpenReply, then sends blocks
+    of blockSize float samples and reads each one back shifted. Closing the
+    connection closes the stream.
+
+    Every stream lives in one jafftune::StreamBank, so a stream costs its
+    delay history and a few values of state rather than a whole engine, and
+    the output is bit for bit what the plugin's Mono mode produces with the
+    same settings. Whenever blocks have arrived they are grouped by block
+    size, cut into batches of --batch streams and spread over a WorkerPool,
+    whose threads (and the I/O thread) claim batches until none are left.
+
+    Every --report seconds the aggregate throughput is printed, as stream
+    seconds of audio per second and the share of that time spent shifting.
+    Each stream prints its turnaround (last byte of a block in to last byte
+    of its reply out) and its algorithmic latency when it closes.
+
+    --loopback runs the server on a temporary socket and --clients threads
+    standing in for the voice pipeline. Each one streams --seconds of audio
+    as fast as the server answers, checks every reply against a
+    PitchShiftEngine<float> in Mono mode, and reports its round trip.
+
+  ==============================================================================
+*/
+
+#include "../Engine/PerformanceMonitor.h"
+#include "../Engine/PitchShiftEngine.h"
+#include "../Engine/StreamBank.h"
+#include "../Engine/WorkerPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if ! defined (_WIN32)
+ #include <fcntl.h>
+ #include <poll.h>
+ #include <sys/socket.h>
+ #include <sys/un.h>
+ #include <unistd.h>
+#endif
+
+namespace
+{
+
+//==============================================================================
+constexpr std::uint32_t protocolMagic = 0x4a545356;     // "JTSV"
+constexpr std::uint32_t protocolVersion = 1;
+constexpr int maximumBlockSize = 65536;
+
+/** Sent once by the client when it connects. */
+struct OpenRequest
+{
+    std::uint32_t magic = protocolMagic;
+    std::uint32_t version = protocolVersion;
+    std::int32_t blockSize = 256;
+    float pitchRatio = 1.0f;
+    float dryGain = 0.0f;
+    float wetGain = 1.0f;
+    float outputGain = 1.0f;
+    float delayWindowMs = 0.0f;         // 0 picks the adaptive window for the ratio, as the plugin does
+    std::int32_t interpolation = 0;     // jafftune::Interpolation
+};
+
+/** The server's answer; stream is -1 if the request was refused. */
+struct OpenReply
+{
+    std::int32_t stream = -1;
+    std::int32_t latencySamples = 0;
+    double sampleRate = 0.0;
+};
+
+struct ServeConfig
+{
+    std::string socketPath = "/tmp/jafftune.sock";
+    double sampleRate = 48000.0;
+    int maximumStreams = 512;
+    float maximumWindowMs = 100.0f;
+    int numThreads = 0;
+    int batchSize = 32;
+    double reportSeconds = 5.0;
+
+    bool loopback = false;
+    int numClients = 64;
+    int blockSize = 480;
+    double seconds = 10.0;
+};
+
+std::atomic<bool> stopRequested { false };
+
+extern "C" void requestStop (int)
+{
+    stopRequested = true;
+}
+
+#if ! defined (_WIN32)
+
+//==============================================================================
+/** The bank's settings for a request, clamped to the plugin's parameter ranges. */
+jafftune::StreamSettings settingsFor (const OpenRequest& request, float maximumWindowMs)
+{
+    jafftune::StreamSettings settings;
+    settings.pitchRatio = std::clamp (request.pitchRatio, 0.5f, 2.0f);
+    settings.dryGain = std::clamp (request.dryGain, 0.0f, 1.0f);
+    settings.wetGain = std::clamp (request.wetGain, 0.0f, 1.0f);
+    settings.outputGain = std::clamp (request.outputGain, 0.0f, 1.0f);
+    settings.delayWindowMs = request.delayWindowMs > 0.0f
+                           ? request.delayWindowMs
+                           : jafftune::PitchShiftEngine<float>::windowForRatio (settings.pitchRatio, maximumWindowMs);
+    settings.interpolation = request.interpolation == (int) jafftune::Interpolation::hermite ? jafftune::Interpolation::hermite
+                                                                                            : jafftune::Interpolation::linear;
+    return settings;
+}
+
+sockaddr_un addressFor (const std::string& path)
+{
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    std::strncpy (address.sun_path, path.c_str(), sizeof (address.sun_path) - 1);
+    return address;
+}
+
+//==============================================================================
+/**
+    The service: one I/O thread polling every connection, handing the blocks
+    that have arrived to the bank in batches.
+*/
+class Server
+{
+public:
+    explicit Server (const ServeConfig& configToUse)
+        : config (configToUse)
+    {
+        bank.prepare (config.sampleRate, config.maximumStreams, config.maximumWindowMs);
+        connections.resize ((size_t) config.maximumStreams);
+        readyStreams.reserve ((size_t) config.maximumStreams);
+        readyBlocks.reserve ((size_t) config.maximumStreams);
+        readyConnections.reserve ((size_t) config.maximumStreams);
+        batches.reserve ((size_t) config.maximumStreams);
+        pollDescriptors.reserve ((size_t) config.maximumStreams + 1);
+
+        const auto numWorkers = config.numThreads > 0 ? config.numThreads - 1
+                                                      : (int) std::thread::hardware_concurrency() - 1;
+        pool.start (std::max (0, numWorkers));
+    }
+
+    ~Server()
+    {
+        for (auto& connection : connections)
+            if (connection.fd >= 0)
+                ::close (connection.fd);
+
+        if (listener >= 0)
+        {
+            ::close (listener);
+            ::unlink (config.socketPath.c_str());
+        }
+    }
+
+    bool listen()
+    {
+        listener = ::socket (AF_UNIX, SOCK_STREAM, 0);
+
+        if (listener < 0)
+            return false;
+
+        ::unlink (config.socketPath.c_str());
+        const auto address = addressFor (config.socketPath);
+
+        if (::bind (listener, reinterpret_cast<const sockaddr*> (&address), sizeof (address)) != 0
+             || ::listen (listener, SOMAXCONN) != 0)
+            return false;
+
+        ::fcntl (listener, F_SETFL, O_NONBLOCK);
+        return true;
+    }
+
+    /** Serves until stop becomes true. */
+    void run (const std::atomic<bool>& stop)
+    {
+        auto lastReport = Clock::now();
+
+        while (! stop)
+        {
+            pollDescriptors.clear();
+            pollDescriptors.push_back ({ listener, POLLIN, 0 });
+
+            for (auto& connection : connections)
+                if (connection.fd >= 0)
+                    pollDescriptors.push_back ({ connection.fd, (short) (connection.state == State::sending ? POLLOUT : POLLIN), 0 });
+
+            if (::poll (pollDescriptors.data(), (nfds_t) pollDescriptors.size(), 50) < 0)
+                continue;
+
+            if ((pollDescriptors[0].revents & POLLIN) != 0)
+                acceptConnections();
+
+            for (size_t p = 1; p < pollDescriptors.size(); ++p)
+                if (pollDescriptors[p].revents != 0)
+                    service (connectionFor (pollDescriptors[p].fd));
+
+            processReadyBlocks();
+
+            if (config.reportSeconds > 0.0 && seconds (Clock::now() - lastReport) >= config.reportSeconds)
+            {
+                report (seconds (Clock::now() - lastReport));
+                lastReport = Clock::now();
+            }
+        }
+    }
+
+private:
+    //==============================================================================
+    using Clock = std::chrono::steady_clock;
+
+    enum class State
+    {
+        opening,        // reading the OpenRequest
+        receiving,      // reading a block
+        ready,          // a whole block is waiting for the next batch
+        sending         // writing the OpenReply or a processed block
+    };
+
+    struct Connection
+    {
+        int fd = -1;
+        int stream = -1;
+        State state = State::opening;
+        OpenRequest request;
+        OpenReply reply;
+        std::vector<float> block;
+        size_t transferred = 0;             // bytes of the current request, block or reply so far
+        bool closeAfterSending = false;
+
+        Clock::time_point blockArrived;
+        std::unique_ptr<jafftune::PerformanceMonitor> turnaround;
+        std::uint64_t blocksProcessed = 0;
+    };
+
+    struct Batch
+    {
+        int first;
+        int count;
+        int blockSize;
+    };
+
+    static double seconds (Clock::duration duration)
+    {
+        return std::chrono::duration<double> (duration).count();
+    }
+
+    Connection& connectionFor (int fd)
+    {
+        return *std::find_if (connections.begin(), connections.end(), [fd] (const Connection& c) { return c.fd == fd; });
+    }
+
+    //==============================================================================
+    void acceptConnections()
+    {
+        for (;;)
+        {
+            const auto fd = ::accept (listener, nullptr, nullptr);
+
+            if (fd < 0)
+                return;
+
+            auto free = std::find_if (connections.begin(), connections.end(), [] (const Connection& c) { return c.fd < 0; });
+
+            //more connections than streams: refuse at once rather than leave the client hanging
+            if (free == connections.end())
+            {
+                ::close (fd);
+                continue;
+            }
+
+            ::fcntl (fd, F_SETFL, O_NONBLOCK);
+            *free = {};
+            free->fd = fd;
+        }
+    }
+
+    void service (Connection& connection)
+    {
+        switch (connection.state)
+        {
+            case State::opening:
+                if (receive (connection, &connection.request, sizeof (OpenRequest)))
+                    open (connection);
+                break;
+
+            case State::receiving:
+                if (receive (connection, connection.block.data(), connection.block.size() * sizeof (float)))
+                {
+                    connection.state = State::ready;
+                    connection.blockArrived = Clock::now();
+                }
+                break;
+
+            case State::sending:
+            {
+                const auto sendingReply = connection.stream < 0 || connection.blocksProcessed == 0;
+                const auto* data = sendingReply ? static_cast<const void*> (&connection.reply) : connection.block.data();
+                const auto size = sendingReply ? sizeof (OpenReply) : connection.block.size() * sizeof (float);
+
+                if (send (connection, data, size))
+                {
+                    if (connection.closeAfterSending)
+                    {
+                        close (connection);
+                        return;
+                    }
+
+                    if (! sendingReply)
+                    {
+                        connection.turnaround->addBlock (Clock::now() - connection.blockArrived, (int) connection.block.size());
+
+                        //drained well before its ring fills, so no timing is dropped
+                        if (connection.blocksProcessed % 512 == 0)
+                            connection.turnaround->collect();
+                    }
+
+                    connection.state = State::receiving;
+                }
+                break;
+            }
+
+            case State::ready:
+            default:
+                break;
+        }
+    }
+
+    /** Reads towards size bytes; true once they have all arrived. */
+    bool receive (Connection& connection, void* destination, size_t size)
+    {
+        const auto received = ::recv (connection.fd, static_cast<char*> (destination) + connection.transferred,
+                                      size - connection.transferred, 0);
+
+        if (received <= 0)
+        {
+            close (connection);
+            return false;
+        }
+
+        connection.transferred += (size_t) received;
+
+        if (connection.transferred < size)
+            return false;
+
+        connection.transferred = 0;
+        return true;
+    }
+
+    /** Writes towards size bytes; true once they have all gone. */
+    bool send (Connection& connection, const void* source, size_t size)
+    {
+        const auto sent = ::send (connection.fd, static_cast<const char*> (source) + connection.transferred,
+                                  size - connection.transferred, 0);
+
+        if (sent <= 0)
+        {
+            close (connection);
+            return false;
+        }
+
+        connection.transferred += (size_t) sent;
+
+        if (connection.transferred < size)
+            return false;
+
+        connection.transferred = 0;
+        return true;
+    }
+
+    void open (Connection& connection)
+    {
+        const auto& request = connection.request;
+        connection.state = State::sending;
+        connection.reply = {};
+        connection.reply.sampleRate = config.sampleRate;
+
+        if (request.magic != protocolMagic || request.version != protocolVersion
+             || request.blockSize <= 0 || request.blockSize > maximumBlockSize)
+        {
+            connection.closeAfterSending = true;
+            return;
+        }
+
+        connection.stream = bank.openStream (settingsFor (request, config.maximumWindowMs));
+
+        if (connection.stream < 0)
+        {
+            connection.closeAfterSending = true;
+            return;
+        }
+
+        connection.block.assign ((size_t) request.blockSize, 0.0f);
+        connection.turnaround = std::make_unique<jafftune::PerformanceMonitor>();
+        connection.turnaround->prepare (config.sampleRate);
+
+        //prepare() leaves the clear to the first collect(), which would otherwise drop the blocks timed before it
+        connection.turnaround->collect();
+
+        connection.reply.stream = connection.stream;
+        connection.reply.latencySamples = bank.getLatencyInSamples (connection.stream);
+    }
+
+    void close (Connection& connection)
+    {
+        if (connection.stream >= 0)
+        {
+            if (connection.blocksProcessed > 0)
+            {
+                const auto stats = connection.turnaround->collect();
+
+                std::printf ("stream %d closed: %llu blocks of %d, latency %.2f ms, turnaround mean %.0f us, p99 %.0f us, max %.0f us\n",
+                             connection.stream, (unsigned long long) connection.blocksProcessed, (int) connection.block.size(),
+                             1000.0 * bank.getLatencyInSamples (connection.stream) / config.sampleRate,
+                             stats.meanMicroseconds, stats.p99Microseconds, stats.maxMicroseconds);
+            }
+
+            bank.closeStream (connection.stream);
+        }
+
+        ::close (connection.fd);
+        connection = {};
+    }
+
+    //==============================================================================
+    void processReadyBlocks()
+    {
+        readyConnections.clear();
+
+        for (auto& connection : connections)
+            if (connection.fd >= 0 && connection.state == State::ready)
+                readyConnections.push_back (&connection);
+
+        if (readyConnections.empty())
+            return;
+
+        //same-sized blocks together, so each batch runs the bank's lanes over one block length
+        std::sort (readyConnections.begin(), readyConnections.end(),
+                   [] (const Connection* a, const Connection* b) { return a->block.size() < b->block.size(); });
+
+        readyStreams.clear();
+        readyBlocks.clear();
+        batches.clear();
+
+        for (auto* connection : readyConnections)
+        {
+            const auto blockSize = (int) connection->block.size();
+
+            if (batches.empty() || batches.back().blockSize != blockSize || batches.back().count == config.batchSize)
+                batches.push_back ({ (int) readyStreams.size(), 0, blockSize });
+
+            ++batches.back().count;
+            readyStreams.push_back (connection->stream);
+            readyBlocks.push_back (connection->block.data());
+            samplesProcessed += (std::uint64_t) blockSize;
+        }
+
+        const auto startTime = Clock::now();
+
+        pool.run ([] (void* context, int index)
+                  {
+                      auto& server = *static_cast<Server*> (context);
+                      const auto& batch = server.batches[(size_t) index];
+                      server.bank.process (server.readyStreams.data() + batch.first, server.readyBlocks.data() + batch.first,
+                                           batch.count, batch.blockSize);
+                  },
+                  this, (int) batches.size());
+
+        processingSeconds += seconds (Clock::now() - startTime);
+
+        for (auto* connection : readyConnections)
+        {
+            ++connection->blocksProcessed;
+            connection->state = State::sending;
+            service (*connection);
+        }
+    }
+
+    void report (double elapsedSeconds)
+    {
+        const auto audioSeconds = (double) samplesProcessed / config.sampleRate;
+
+        std::printf ("%d streams open, %.1f stream-seconds per second (%.1fx realtime), %.1f%% of it shifting on %d threads\n",
+                     bank.getNumOpenStreams(), audioSeconds / elapsedSeconds, audioSeconds / elapsedSeconds,
+                     100.0 * processingSeconds / elapsedSeconds, pool.getNumWorkers() + 1);
+        std::fflush (stdout);
+
+        samplesProcessed = 0;
+        processingSeconds = 0.0;
+    }
+
+    //==============================================================================
+    const ServeConfig config;
+    jafftune::StreamBank bank;
+    jafftune::WorkerPool pool;
+    int listener = -1;
+
+    std::vector<Connection> connections;
+    std::vector<pollfd> pollDescriptors;
+
+    //the blocks in the current round of batches
+    std::vector<Connection*> readyConnections;
+    std::vector<int> readyStreams;
+    std::vector<float*> readyBlocks;
+    std::vector<Batch> batches;
+
+    std::uint64_t samplesProcessed = 0;
+    double processingSeconds = 0.0;
+};
+
+//==============================================================================
+bool sendAll (int fd, const void* source, size_t size)
+{
+    for (size_t done = 0; done < size;)
+    {
+        const auto sent = ::send (fd, static_cast<const char*> (source) + done, size - done, 0);
+
+        if (sent <= 0)
+            return false;
+
+        done += (size_t) sent;
+    }
+
+    return true;
+}
+
+bool receiveAll (int fd, void* destination, size_t size)
+{
+    for (size_t done = 0; done < size;)
+    {
+        const auto received = ::recv (fd, static_cast<char*> (destination) + done, size - done, 0);
+
+        if (received <= 0)
+            return false;
+
+        done += (size_t) received;
+    }
+
+    return true;
+}
+
+struct ClientResult
+{
+    bool connected = false;
+    double pitchRatio = 1.0;
+    double latencyMs = 0.0;
+    std::vector<float> roundTrips;      // microseconds, one per block
+    std::uint64_t mismatchingSamples = 0;
+};
+
+/** A stand-in for one pipeline stream: a voice-like tone, sent as fast as the server replies. */
+ClientResult runClient (const ServeConfig& config, int index)
+{
+    ClientResult result;
+
+    const auto fd = ::socket (AF_UNIX, SOCK_STREAM, 0);
+    const auto address = addressFor (config.socketPath);
+
+    if (fd < 0 || ::connect (fd, reinterpret_cast<const sockaddr*> (&address), sizeof (address)) != 0)
+    {
+        if (fd >= 0)
+            ::close (fd);
+
+        return result;
+    }
+
+    OpenRequest request;
+    request.blockSize = config.blockSize;
+    request.pitchRatio = 0.6f + 0.8f * (float) (index % 17) / 16.0f;
+    request.dryGain = index % 3 == 0 ? 0.3f : 0.0f;
+    request.wetGain = 1.0f - request.dryGain;
+    request.outputGain = 0.8f;
+    request.interpolation = index % 2;
+
+    OpenReply reply;
+
+    if (! sendAll (fd, &request, sizeof (request)) || ! receiveAll (fd, &reply, sizeof (reply)) || reply.stream < 0)
+    {
+        ::close (fd);
+        return result;
+    }
+
+    result.connected = true;
+    result.pitchRatio = (double) request.pitchRatio;
+    result.latencyMs = 1000.0 * reply.latencySamples / reply.sampleRate;
+
+    //the same settings through an engine of its own, as the plugin's Mono mode would run them
+    const auto settings = settingsFor (request, config.maximumWindowMs);
+    jafftune::PitchShiftEngine<float> reference;
+    reference.setMaximumDelayWindow (config.maximumWindowMs);
+    reference.setDelayWindow (settings.delayWindowMs);
+    reference.setPitchRatio (settings.pitchRatio);
+    reference.setMix (settings.dryGain, settings.wetGain);
+    reference.setOutputGain (settings.outputGain);
+    reference.setInterpolation (settings.interpolation);
+    reference.prepare (reply.sampleRate, config.blockSize, 1);
+
+    const auto numBlocks = (int) std::ceil (config.seconds * reply.sampleRate / config.blockSize);
+    const auto fundamental = 110.0 + 15.0 * index;
+    std::vector<float> block ((size_t) config.blockSize), expected ((size_t) config.blockSize);
+    result.roundTrips.reserve ((size_t) numBlocks);
+
+    for (int b = 0; b < numBlocks; ++b)
+    {
+        for (int i = 0; i < config.blockSize; ++i)
+        {
+            const auto t = (double) (b * config.blockSize + i) / reply.sampleRate;
+            const auto envelope = 0.5 + 0.5 * std::sin (2.0 * 3.141592653589793 * 3.0 * t);
+            block[(size_t) i] = (float) (envelope * (0.4 * std::sin (2.0 * 3.141592653589793 * fundamental * t)
+                                                   + 0.1 * std::sin (2.0 * 3.141592653589793 * 3.0 * fundamental * t)));
+        }
+
+        expected = block;
+        float* channels[] = { expected.data() };
+        reference.process (channels, 1, config.blockSize, jafftune::OperationMode::mono);
+
+        const auto startTime = std::chrono::steady_clock::now();
+
+        if (! sendAll (fd, block.data(), block.size() * sizeof (float))
+             || ! receiveAll (fd, block.data(), block.size() * sizeof (float)))
+            break;
+
+        result.roundTrips.push_back ((float) std::chrono::duration<double, std::micro> (std::chrono::steady_clock::now() - startTime).count());
+
+        if (std::memcmp (block.data(), expected.data(), block.size() * sizeof (float)) != 0)
+            for (size_t i = 0; i < block.size(); ++i)
+                result.mismatchingSamples += block[i] != expected[i] ? 1 : 0;
+    }
+
+    ::close (fd);
+    return result;
+}
+
+/** Serves a temporary socket to config.numClients stand-in clients and summarises them. */
+int runLoopback (ServeConfig config)
+{
+    config.socketPath = "/tmp/jafftune-loopback-" + std::to_string ((long) ::getpid()) + ".sock";
+    config.maximumStreams = std::max (config.maximumStreams, config.numClients);
+    config.reportSeconds = 0.0;
+
+    Server server (config);
+
+    if (! server.listen())
+    {
+        std::fprintf (stderr, "cannot listen on %s\n", config.socketPath.c_str());
+        return 1;
+    }
+
+    std::atomic<bool> stopServer { false };
+    std::thread serverThread ([&] { server.run (stopServer); });
+
+    std::vector<ClientResult> results ((size_t) config.numClients);
+    std::vector<std::thread> clients;
+    const auto startTime = std::chrono::steady_clock::now();
+
+    for (int c = 0; c < config.numClients; ++c)
+        clients.emplace_back ([&, c] { results[(size_t) c] = runClient (config, c); });
+
+    for (auto& client : clients)
+        client.join();
+
+    const auto wallSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now() - startTime).count();
+    stopServer = true;
+    serverThread.join();
+
+    std::uint64_t totalBlocks = 0, totalMismatches = 0;
+    int numConnected = 0;
+
+    for (size_t c = 0; c < results.size(); ++c)
+    {
+        auto& result = results[c];
+
+        if (! result.connected)
+        {
+            std::printf ("client %d: refused\n", (int) c);
+            continue;
+        }
+
+        ++numConnected;
+        totalBlocks += result.roundTrips.size();
+        totalMismatches += result.mismatchingSamples;
+
+        auto sorted = result.roundTrips;
+        std::sort (sorted.begin(), sorted.end());
+        const auto percentile = [&] (double fraction) { return sorted.empty() ? 0.0 : (double) sorted[(size_t) (fraction * (double) (sorted.size() - 1))]; };
+
+        std::printf ("client %d: ratio %.3f, latency %.2f ms, round trip median %.0f us, p99 %.0f us, max %.0f us, %llu mismatching samples\n",
+                     (int) c, result.pitchRatio, result.latencyMs, percentile (0.5), percentile (0.99),
+                     sorted.empty() ? 0.0 : (double) sorted.back(), (unsigned long long) result.mismatchingSamples);
+    }
+
+    const auto audioSeconds = (double) totalBlocks * config.blockSize / config.sampleRate;
+
+    std::printf ("%d streams, %.1f stream-seconds of audio in %.2fs (%.1fx realtime), %llu mismatching samples\n",
+                 numConnected, audioSeconds, wallSeconds, audioSeconds / std::max (1.0e-9, wallSeconds),
+                 (unsigned long long) totalMismatches);
+
+    return numConnected == config.numClients && totalMismatches == 0 ? 0 : 1;
+}
+
+#endif
+
+//==============================================================================
+void printUsage()
+{
+    std::fprintf (stderr,
+                  "usage: jafftune_serve [--socket path] [--sample-rate hz] [--max-streams n] [--max-window ms]\n"
+                  "                      [--threads n] [--batch n] [--report seconds]\n"
+                  "       jafftune_serve --loopback [--clients n] [--block-size n] [--seconds s]\n"
+                  "                      [--sample-rate hz] [--threads n] [--batch n]\n");
+}
+
+bool parseArguments (int argc, char* argv[], ServeConfig& config)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg (argv[i]);
+        const auto hasValue = i + 1 < argc;
+
+        if (arg == "--socket" && hasValue)             config.socketPath = argv[++i];
+        else if (arg == "--sample-rate" && hasValue)   config.sampleRate = std::max (8000.0, std::atof (argv[++i]));
+        else if (arg == "--max-streams" && hasValue)   config.maximumStreams = std::max (1, std::atoi (argv[++i]));
+        else if (arg == "--max-window" && hasValue)    config.maximumWindowMs = std::max (1.0f, (float) std::atof (argv[++i]));
+        else if (arg == "--threads" && hasValue)       config.numThreads = std::max (1, std::atoi (argv[++i]));
+        else if (arg == "--batch" && hasValue)         config.batchSize = std::max (1, std::atoi (argv[++i]));
+        else if (arg == "--report" && hasValue)        config.reportSeconds = std::atof (argv[++i]);
+        else if (arg == "--loopback")                  config.loopback = true;
+        else if (arg == "--clients" && hasValue)       config.numClients = std::max (1, std::atoi (argv[++i]));
+        else if (arg == "--block-size" && hasValue)    config.blockSize = std::clamp (std::atoi (argv[++i]), 1, maximumBlockSize);
+        else if (arg == "--seconds" && hasValue)       config.seconds = std::max (0.01, std::atof (argv[++i]));
+        else
+            return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    ServeConfig config;
+
+    if (! parseArguments (argc, argv, config))
+    {
+        printUsage();
+        return 1;
+    }
+
+   #if defined (_WIN32)
+    std::fprintf (stderr, "jafftune_serve needs Unix domain sockets, which this build doesn't have\n");
+    return 1;
+   #else
+    //a client that hangs up mid-reply is handled where send() fails
+    std::signal (SIGPIPE, SIG_IGN);
+
+    if (config.loopback)
+        return runLoopback (config);
+
+    std::signal (SIGINT, requestStop);
+    std::signal (SIGTERM, requestStop);
+
+    Server server (config);
+
+    if (! server.listen())
+    {
+        std::fprintf (stderr, "cannot listen on %s\n", config.socketPath.c_str());
+        return 1;
+    }
+
+    std::printf ("serving up to %d streams at %.0f Hz on %s\n", config.maximumStreams, config.sampleRate, config.socketPath.c_str());
+    std::fflush (stdout);
+
+    server.run (stopRequested);
+    return 0;
+   #endif
+}